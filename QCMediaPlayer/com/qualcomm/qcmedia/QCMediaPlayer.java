@@ -395,6 +395,30 @@ public class QCMediaPlayer extends MediaPlayer
   public static final int KEY_DASH_PAUSE_EVENT = 7002;
   public static final int KEY_DASH_RESUME_EVENT = 7003;
 
+  /**
+   * Playback rate in 1/1000, 500 to 2000. Set with QCsetParameter().
+   */
+  public static final int KEY_DASH_PLAYBACK_RATE = 7004;
+
+  /**
+   * Live mode target latency behind the live edge in ms, 0 turns live mode
+   * off. Set with QCsetParameter(). The periodic QOE parcel then ends with
+   * int live mode, long target ms, long latency ms, long mean latency ms,
+   * long latency variance ms^2 and int playback rate in 1/1000.
+   */
+  public static final int KEY_DASH_LIVE_TARGET_LATENCY = 7005;
+
+  /**
+   * Where playback resumes after the seeks that follow, one of the
+   * SEEK_* values below. Set with QCsetParameter(), the default is
+   * SEEK_EXACT.
+   */
+  public static final int KEY_DASH_SEEK_MODE = 7006;
+  public static final int SEEK_PREVIOUS_SYNC = 0;
+  public static final int SEEK_NEXT_SYNC = 1;
+  public static final int SEEK_CLOSEST_SYNC = 2;
+  public static final int SEEK_EXACT = 3;
+
   public static final int KEY_QCTIMEDTEXT_LISTENER = 6000;
 
   enum MediaPlayerState {
@@ -8,6 +8,15 @@ LOCAL_SRC_FILES:=                       \
         DashPlayer.cpp                  \
         DashPlayerDriver.cpp            \
         DashPlayerRenderer.cpp          \
+        DashPlayerCaptionExtractor.cpp  \
+        DashCaptionParser.cpp           \
+        DashVideoFrameScheduler.cpp     \
+        DashAudioClock.cpp              \
+        DashAudioRing.cpp               \
+        DashFrameDropController.cpp     \
+        DashNALClassifier.cpp           \
+        DashLiveLatencyController.cpp   \
+        DashTimeStretcher.cpp           \
         DashPlayerStats.cpp             \
         DashPlayerDecoder.cpp           \
         DashPacketSource.cpp            \
@@ -56,3 +65,4 @@ ifeq ($(TARGET_ENABLE_QC_AV_ENHANCEMENTS), true)
  include $(BUILD_SHARED_LIBRARY)
 endif
 
+include $(LOCAL_PATH)/tests/Android.mk
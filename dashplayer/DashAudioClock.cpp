@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashAudioClock"
+
+#include "DashAudioClock.h"
+#include <cutils/properties.h>
+#include <utils/Log.h>
+
+namespace android {
+
+// How often the sink position is read by default.
+static const int64_t kDefaultSampleIntervalUs = 100000ll;
+
+// Errors beyond this are not smoothed out, the estimate jumps to the sink
+// position (underrun, stalled or restarted track).
+static const int64_t kMaxSmoothedErrorUs = 20000ll;
+
+// Drift correction is bounded to +/- 0.5% of the nominal rate.
+static const double kMaxRateCorrection = 0.005;
+
+DashAudioClock::DashAudioClock(const sp<MediaPlayerBase::AudioSink> &sink)
+    : mAudioSink(sink),
+      mSampleIntervalUs(kDefaultSampleIntervalUs),
+      mValid(false),
+      mSampleTimeUs(0),
+      mSampleFrames(0),
+      mLastFramesPlayed(0),
+      mFramesPerUs(0.0),
+      mNominalFramesPerUs(0.0) {
+    char property_value[PROPERTY_VALUE_MAX] = {0};
+    property_get("persist.dash.audioclock.sample.ms", property_value, NULL);
+    if (*property_value && atoi(property_value) >= 0) {
+        mSampleIntervalUs = atoi(property_value) * 1000ll;
+    }
+}
+
+DashAudioClock::~DashAudioClock() {
+}
+
+void DashAudioClock::reset() {
+    mValid = false;
+    mLastFramesPlayed = 0;
+}
+
+int64_t DashAudioClock::getDurationUs(uint32_t numFrames) const {
+    uint32_t sampleRate = mAudioSink->getSampleRate();
+    if (sampleRate == 0) {
+        return 0;
+    }
+    return (int64_t)numFrames * 1000000ll / sampleRate;
+}
+
+uint32_t DashAudioClock::extrapolate(int64_t nowUs) const {
+    int64_t elapsedUs = nowUs - mSampleTimeUs;
+    if (elapsedUs <= 0) {
+        return mSampleFrames;
+    }
+    return mSampleFrames + (uint32_t)(elapsedUs * mFramesPerUs);
+}
+
+status_t DashAudioClock::getFramesPlayed(
+        int64_t nowUs, uint32_t numFramesWritten, uint32_t *numFramesPlayed) {
+    if (!mValid || nowUs - mSampleTimeUs >= mSampleIntervalUs) {
+        uint32_t measured;
+        status_t err = mAudioSink->getPosition(&measured);
+        if (err != OK) {
+            return err;
+        }
+
+        uint32_t sampleRate = mAudioSink->getSampleRate();
+        mNominalFramesPerUs = sampleRate / 1E6;
+
+        if (!mValid || mSampleIntervalUs == 0) {
+            mFramesPerUs = mNominalFramesPerUs;
+            mSampleFrames = measured;
+            mLastFramesPlayed = measured;
+        } else {
+            uint32_t predicted = extrapolate(nowUs);
+            int32_t errFrames = (int32_t)(measured - predicted);
+
+            // steer the rate so the error is absorbed over the next interval
+            double correction =
+                errFrames / (mNominalFramesPerUs * mSampleIntervalUs);
+            if (correction > kMaxRateCorrection) {
+                correction = kMaxRateCorrection;
+            } else if (correction < -kMaxRateCorrection) {
+                correction = -kMaxRateCorrection;
+            }
+            mFramesPerUs = mNominalFramesPerUs * (1.0 + correction);
+
+            int64_t errUs = getDurationUs(errFrames < 0 ? -errFrames : errFrames);
+            mSampleFrames = (errUs > kMaxSmoothedErrorUs)
+                ? measured : predicted + errFrames / 2;
+        }
+
+        mSampleTimeUs = nowUs;
+        mValid = true;
+    }
+
+    uint32_t frames = extrapolate(nowUs);
+    if ((int32_t)(frames - numFramesWritten) > 0) {
+        frames = numFramesWritten;
+    }
+    if ((int32_t)(frames - mLastFramesPlayed) < 0) {
+        frames = mLastFramesPlayed;
+    }
+    mLastFramesPlayed = frames;
+
+    *numFramesPlayed = frames;
+    return OK;
+}
+
+}  // namespace android
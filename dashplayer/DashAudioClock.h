@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_AUDIO_CLOCK_H_
+
+#define DASH_AUDIO_CLOCK_H_
+
+#include <media/MediaPlayerInterface.h>
+
+namespace android {
+
+// Estimates the audio sink's playback position without asking AudioFlinger
+// on every query. The sink position is sampled at a low rate, in between it
+// is extrapolated from the sample rate with a small correction for drift
+// between the sink and the system clock. Estimates never go backwards and
+// never pass the number of frames written.
+struct DashAudioClock : public RefBase {
+    DashAudioClock(const sp<MediaPlayerBase::AudioSink> &sink);
+
+    // Forgets the current estimate, the next query samples the sink. Must
+    // be called whenever the sink stops, restarts or is reopened.
+    void reset();
+
+    // Frames played out by the sink at nowUs.
+    status_t getFramesPlayed(
+            int64_t nowUs, uint32_t numFramesWritten, uint32_t *numFramesPlayed);
+
+    // Playback duration of numFrames.
+    int64_t getDurationUs(uint32_t numFrames) const;
+
+protected:
+    virtual ~DashAudioClock();
+
+private:
+    sp<MediaPlayerBase::AudioSink> mAudioSink;
+
+    int64_t mSampleIntervalUs;
+
+    bool mValid;
+    int64_t mSampleTimeUs;      // when the sink was last sampled
+    uint32_t mSampleFrames;     // the (corrected) position at that time
+    uint32_t mLastFramesPlayed; // last value handed out
+    double mFramesPerUs;        // nominal rate times drift correction
+    double mNominalFramesPerUs;
+
+    uint32_t extrapolate(int64_t nowUs) const;
+
+    DashAudioClock(const DashAudioClock &);
+    DashAudioClock &operator=(const DashAudioClock &);
+};
+
+}  // namespace android
+
+#endif  // DASH_AUDIO_CLOCK_H_
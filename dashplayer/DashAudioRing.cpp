@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashAudioRing"
+
+#include "DashAudioRing.h"
+#include <string.h>
+
+namespace android {
+
+DashAudioRing::DashAudioRing(size_t capacity)
+    : mData(NULL),
+      mCapacity(1),
+      mWritten(0),
+      mRead(0),
+      mBytesRead(0),
+      mFlushPosition(0),
+      mFlushGeneration(0),
+      mConsumerFlushGeneration(0) {
+    while (mCapacity < capacity) {
+        mCapacity <<= 1;
+    }
+    mData = new uint8_t[mCapacity];
+}
+
+DashAudioRing::~DashAudioRing() {
+    delete[] mData;
+    mData = NULL;
+}
+
+size_t DashAudioRing::getFilledBytes() const {
+    int32_t written = android_atomic_acquire_load(&mWritten);
+    int32_t read = android_atomic_acquire_load(&mRead);
+    return (size_t)(uint32_t)(written - read);
+}
+
+size_t DashAudioRing::getFreeBytes() const {
+    return mCapacity - getFilledBytes();
+}
+
+uint32_t DashAudioRing::getBytesRead() const {
+    return (uint32_t)android_atomic_acquire_load(&mBytesRead);
+}
+
+size_t DashAudioRing::write(const void *data, size_t size) {
+    size_t freeBytes = getFreeBytes();
+    if (size > freeBytes) {
+        size = freeBytes;
+    }
+
+    int32_t written = mWritten;
+    size_t pos = (uint32_t)written & (mCapacity - 1);
+    size_t first = mCapacity - pos;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(mData + pos, data, first);
+    memcpy(mData, (const uint8_t *)data + first, size - first);
+
+    android_atomic_release_store(written + (int32_t)size, &mWritten);
+    return size;
+}
+
+size_t DashAudioRing::read(void *data, size_t size) {
+    int32_t generation = android_atomic_acquire_load(&mFlushGeneration);
+    if (generation != mConsumerFlushGeneration) {
+        mConsumerFlushGeneration = generation;
+        int32_t flushPosition = android_atomic_acquire_load(&mFlushPosition);
+        // only skip forward, data written after the flush stays
+        if ((int32_t)(flushPosition - mRead) > 0) {
+            android_atomic_release_store(flushPosition, &mRead);
+        }
+    }
+
+    int32_t read = mRead;
+    size_t filled =
+        (size_t)(uint32_t)(android_atomic_acquire_load(&mWritten) - read);
+    if (size > filled) {
+        size = filled;
+    }
+
+    size_t pos = (uint32_t)read & (mCapacity - 1);
+    size_t first = mCapacity - pos;
+    if (first > size) {
+        first = size;
+    }
+    memcpy(data, mData + pos, first);
+    memcpy((uint8_t *)data + first, mData, size - first);
+
+    android_atomic_release_store(read + (int32_t)size, &mRead);
+    android_atomic_add((int32_t)size, &mBytesRead);
+    return size;
+}
+
+void DashAudioRing::flush() {
+    android_atomic_release_store(mWritten, &mFlushPosition);
+    android_atomic_inc(&mFlushGeneration);
+}
+
+}  // namespace android
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_AUDIO_RING_H_
+
+#define DASH_AUDIO_RING_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+// Audio byte ring between the renderer, which writes decoded (or, when
+// offloading, compressed) audio, and an AudioSink callback thread, which
+// pulls it. Single producer, single
+// consumer, neither side blocks or takes a lock. write(), flush() and
+// getFreeBytes() belong to the producer; read() to the consumer. The
+// remaining queries are safe from either side.
+struct DashAudioRing : public RefBase {
+    // capacity is rounded up to a power of two.
+    DashAudioRing(size_t capacity);
+
+    size_t write(const void *data, size_t size);
+    size_t read(void *data, size_t size);
+
+    // Drops everything written so far. The consumer discards the data on
+    // its next read(), so this is safe while callbacks are running.
+    void flush();
+
+    size_t getFreeBytes() const;
+    size_t getFilledBytes() const;
+
+    // Bytes handed out by read() since construction.
+    uint32_t getBytesRead() const;
+
+    size_t getCapacity() const { return mCapacity; }
+
+protected:
+    virtual ~DashAudioRing();
+
+private:
+    uint8_t *mData;
+    size_t mCapacity;
+
+    // free running byte counts, the position is taken modulo mCapacity
+    volatile int32_t mWritten;
+    volatile int32_t mRead;
+    volatile int32_t mBytesRead;
+
+    // flush() publishes the position to skip to, then bumps the generation
+    volatile int32_t mFlushPosition;
+    volatile int32_t mFlushGeneration;
+    int32_t mConsumerFlushGeneration;  // consumer side only
+
+    DISALLOW_EVIL_CONSTRUCTORS(DashAudioRing);
+};
+
+}  // namespace android
+
+#endif  // DASH_AUDIO_RING_H_
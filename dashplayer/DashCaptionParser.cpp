@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashCaptionParser"
+
+#include "DashCaptionParser.h"
+
+#include <string.h>
+
+namespace android {
+
+/*
+ * user_data_registered_itu_t_t35 ( ) {
+ *   itu_t_t35_country_code  0xB5    (8 bits)
+ *   itu_t_t35_provider_code 0x0031  (16 bits)
+ *   user_identifier         'GA94'  (32 bits)
+ *   user_data_type_code     0x03    (8 bits, MPEG_cc_data())
+ *   ...
+ * }
+ */
+static const uint8_t kCCDataHeader[] = {
+    0xB5, 0x00, 0x31, 0x47, 0x41, 0x39, 0x34, 0x03
+};
+
+// each cc_data ends with marker bits
+static const uint8_t kCCDataMarker = 0xFF;
+
+const uint8_t *DashFindByte(const uint8_t *data, size_t size, uint8_t value) {
+    if (data == NULL || size == 0) {
+        return NULL;
+    }
+    // libc's memchr is already vectorised, NEON on bionic
+    return static_cast<const uint8_t *>(memchr(data, value, size));
+}
+
+bool FindCEACCData(
+        const uint8_t *data, size_t size,
+        const uint8_t **ccData, size_t *ccSize) {
+    if (data == NULL || size <= sizeof(kCCDataHeader)
+            || memcmp(data, kCCDataHeader, sizeof(kCCDataHeader))) {
+        return false;
+    }
+
+    const uint8_t *start = data + sizeof(kCCDataHeader);
+    const uint8_t *marker =
+        DashFindByte(start, size - sizeof(kCCDataHeader), kCCDataMarker);
+    if (marker == NULL || marker == start) {
+        // unterminated or empty
+        return false;
+    }
+
+    *ccData = start;
+    *ccSize = marker - start;
+    return true;
+}
+
+}  // namespace android
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_CAPTION_PARSER_H_
+
+#define DASH_CAPTION_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+// Returns the first byte equal to value in [data, data + size), or NULL.
+// An empty or NULL range finds nothing.
+const uint8_t *DashFindByte(const uint8_t *data, size_t size, uint8_t value);
+
+// Looks for ATSC MPEG_cc_data() in the payload of an ITU-T T.35 registered
+// user data SEI (country 0xB5, provider 0x0031, 'GA94', type 0x03). On
+// success points *ccData at the bytes following the header, up to but not
+// including the 0xFF marker, and returns true. Never reads past size.
+bool FindCEACCData(
+        const uint8_t *data, size_t size,
+        const uint8_t **ccData, size_t *ccSize);
+
+}  // namespace android
+
+#endif  // DASH_CAPTION_PARSER_H_
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashFrameDropController"
+
+#include "DashFrameDropController.h"
+#include <media/stagefright/MediaDefs.h>
+#include <utils/Log.h>
+
+namespace android {
+
+// Matches the renderer's default persist.dash.avsync.window.msec.
+static const int64_t kDefaultRenderWindowUs = 40000ll;
+
+// Latency averages follow new samples with this weight (1/8).
+static const int kSmoothingShift = 3;
+
+// The drop level changes by at most one step per this many frames, so
+// the effect of a step shows in the latency before the next one.
+static const size_t kFramesPerDropLevelStep = 15;
+
+DashFrameDropController::DashFrameDropController()
+    : mCanDrop(false),
+      mRenderWindowUs(kDefaultRenderWindowUs),
+      mHaveLateness(false),
+      mSmoothedLateUs(0),
+      mHaveDecodeLatency(false),
+      mSmoothedDecodeUs(0),
+      mMinDecodeUs(0),
+      mDropLevel(0),
+      mFramesAtDropLevel(0),
+      mMaxTemporalId(0) {
+}
+
+DashFrameDropController::~DashFrameDropController() {
+}
+
+void DashFrameDropController::setMime(const char *mime) {
+    Mutex::Autolock autoLock(mLock);
+    mCanDrop = !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC)
+        || !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_HEVC);
+    mMaxTemporalId = 0;
+}
+
+void DashFrameDropController::setRenderWindowUs(int64_t windowUs) {
+    Mutex::Autolock autoLock(mLock);
+    mRenderWindowUs = windowUs;
+}
+
+void DashFrameDropController::reset() {
+    Mutex::Autolock autoLock(mLock);
+    mHaveLateness = false;
+    mSmoothedLateUs = 0;
+    mHaveDecodeLatency = false;
+    mSmoothedDecodeUs = 0;
+    mMinDecodeUs = 0;
+    mDropLevel = 0;
+    mFramesAtDropLevel = 0;
+}
+
+void DashFrameDropController::onFrameDecoded(int64_t decodeLatencyUs) {
+    if (decodeLatencyUs < 0) {
+        return;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    if (!mHaveDecodeLatency) {
+        mSmoothedDecodeUs = decodeLatencyUs;
+        mMinDecodeUs = decodeLatencyUs;
+        mHaveDecodeLatency = true;
+        return;
+    }
+
+    mSmoothedDecodeUs += (decodeLatencyUs - mSmoothedDecodeUs) >> kSmoothingShift;
+    if (decodeLatencyUs < mMinDecodeUs) {
+        mMinDecodeUs = decodeLatencyUs;
+    }
+}
+
+void DashFrameDropController::onFrameRendered(int64_t lateByUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mHaveLateness) {
+        mSmoothedLateUs = lateByUs;
+        mHaveLateness = true;
+        return;
+    }
+
+    mSmoothedLateUs += (lateByUs - mSmoothedLateUs) >> kSmoothingShift;
+}
+
+// How late a frame entering the decoder now is expected to be rendered:
+// the current lateness plus however much decoding has slowed down since
+// the pipeline was last drained.
+int64_t DashFrameDropController::getExpectedLatenessUs_l() const {
+    int64_t lateUs = mHaveLateness ? mSmoothedLateUs : 0;
+    if (mHaveDecodeLatency && mSmoothedDecodeUs > mMinDecodeUs) {
+        lateUs += mSmoothedDecodeUs - mMinDecodeUs;
+    }
+    return lateUs;
+}
+
+// Starts dropping at half the render window and escalates while frames
+// are still expected beyond it, steps back down below a quarter.
+void DashFrameDropController::updateDropLevel_l() {
+    ++mFramesAtDropLevel;
+
+    int64_t expectedLateUs = getExpectedLatenessUs_l();
+    int level = mDropLevel;
+    if (mDropLevel == 0) {
+        if (expectedLateUs > mRenderWindowUs / 2) {
+            level = 1;
+        }
+    } else if (mFramesAtDropLevel >= kFramesPerDropLevelStep) {
+        if (expectedLateUs > mRenderWindowUs && mDropLevel <= mMaxTemporalId) {
+            level = mDropLevel + 1;
+        } else if (expectedLateUs < mRenderWindowUs / 4) {
+            level = mDropLevel - 1;
+        }
+    }
+
+    if (level != mDropLevel) {
+        ALOGV("expected lateness %lld us, drop level %d -> %d",
+                (long long)expectedLateUs, mDropLevel, level);
+        mDropLevel = level;
+        mFramesAtDropLevel = 0;
+    }
+}
+
+bool DashFrameDropController::isDroppable_l(const DashNALInfo &info) const {
+    if (!info.mValid || info.mIsRandomAccess || mDropLevel == 0) {
+        return false;
+    }
+
+    // Nothing references a higher temporal id, the top sub-layers can go
+    // as a whole. The base layer is kept.
+    int firstDroppedLayer = mMaxTemporalId - (mDropLevel - 2);
+    if (mDropLevel > 1 && info.mTemporalId > 0
+            && info.mTemporalId >= firstDroppedLayer) {
+        return true;
+    }
+
+    // Non-reference pictures may still be referenced by higher sub-layers.
+    return info.mIsNonReference && info.mTemporalId == mMaxTemporalId;
+}
+
+bool DashFrameDropController::shouldDropBeforeDecode(const DashNALInfo &info) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mCanDrop) {
+        return false;
+    }
+
+    if (info.mValid && info.mTemporalId > mMaxTemporalId) {
+        mMaxTemporalId = info.mTemporalId;
+    }
+
+    updateDropLevel_l();
+    return isDroppable_l(info);
+}
+
+}  // namespace android
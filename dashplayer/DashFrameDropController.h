@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_FRAME_DROP_CONTROLLER_H_
+
+#define DASH_FRAME_DROP_CONTROLLER_H_
+
+#include "DashNALClassifier.h"
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Decides which video access units to drop before they are decoded. The
+// renderer reports how late every frame is, the player how long every
+// frame took to decode. Once the lateness expected for frames entering the
+// decoder now approaches the renderer's A/V sync window, non-reference
+// AVC and HEVC frames on the top temporal sub-layer are dropped so the
+// decoder catches up before the renderer has to discard decoded frames.
+// If that is not enough, whole temporal sub-layers go, from the top, but
+// never the base layer. Called from the player and the renderer thread.
+struct DashFrameDropController : public RefBase {
+    DashFrameDropController();
+
+    // Anything but AVC and HEVC is never dropped before decoding.
+    void setMime(const char *mime);
+
+    // Lateness beyond which the renderer drops decoded frames.
+    void setRenderWindowUs(int64_t windowUs);
+
+    // Forgets the latency history, e.g. on flush.
+    void reset();
+
+    void onFrameDecoded(int64_t decodeLatencyUs);
+    void onFrameRendered(int64_t lateByUs);
+
+    // info classifies the access unit, see ClassifyNALUnits(). The player
+    // needs it for seeking as well, so the bitstream is read only once.
+    bool shouldDropBeforeDecode(const DashNALInfo &info);
+
+protected:
+    virtual ~DashFrameDropController();
+
+private:
+    Mutex mLock;
+    bool mCanDrop;
+    int64_t mRenderWindowUs;
+
+    bool mHaveLateness;
+    int64_t mSmoothedLateUs;
+    bool mHaveDecodeLatency;
+    int64_t mSmoothedDecodeUs;
+    int64_t mMinDecodeUs;  // decode latency with an empty pipeline
+
+    // 0: nothing is dropped, 1: non-reference pictures on the top
+    // temporal sub-layer, n > 1: additionally every picture on the top
+    // n - 1 sub-layers above the base layer.
+    int mDropLevel;
+    size_t mFramesAtDropLevel;
+
+    // highest temporal id seen since the format was set
+    int mMaxTemporalId;
+
+    int64_t getExpectedLatenessUs_l() const;
+    void updateDropLevel_l();
+    bool isDroppable_l(const DashNALInfo &info) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(DashFrameDropController);
+};
+
+}  // namespace android
+
+#endif  // DASH_FRAME_DROP_CONTROLLER_H_
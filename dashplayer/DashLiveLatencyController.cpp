@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashLiveLatencyController"
+
+#include "DashLiveLatencyController.h"
+#include <utils/Log.h>
+
+namespace android {
+
+// Within this distance of the target the rate returns to 1x, beyond
+// twice of it the rate changes.
+static const int64_t kToleranceUs = 250000ll;
+
+// Small enough to go unnoticed in speech and music.
+static const float kCatchUpRate = 1.05f;
+static const float kFallBackRate = 0.95f;
+
+// Catching up drains the buffer, so it needs a reserve, and is held off
+// for a while after the source ran dry.
+static const int64_t kMinBufferedForCatchUpUs = 1000000ll;
+static const int64_t kRebufferHoldOffUs = 10000000ll;
+
+// Latency samples follow new values with this weight (1/4).
+static const int kSmoothingShift = 2;
+
+DashLiveLatencyController::DashLiveLatencyController()
+    : mTargetUs(0),
+      mHaveLatency(false),
+      mSmoothedLatencyUs(0),
+      mRate(1.0f),
+      mLastRebufferUs(-1ll),
+      mLastLatencyUs(-1ll),
+      mNumSamples(0),
+      mMeanMs(0),
+      mM2Ms(0) {
+}
+
+DashLiveLatencyController::~DashLiveLatencyController() {
+}
+
+void DashLiveLatencyController::setTargetLatencyUs(int64_t targetUs) {
+    Mutex::Autolock autoLock(mLock);
+    mTargetUs = targetUs > 0 ? targetUs : 0;
+    if (mTargetUs == 0) {
+        mRate = 1.0f;
+    }
+}
+
+bool DashLiveLatencyController::isEnabled() const {
+    Mutex::Autolock autoLock(mLock);
+    return mTargetUs > 0;
+}
+
+void DashLiveLatencyController::reset() {
+    Mutex::Autolock autoLock(mLock);
+    mHaveLatency = false;
+    mSmoothedLatencyUs = 0;
+    mRate = 1.0f;
+    mLastLatencyUs = -1ll;
+    mNumSamples = 0;
+    mMeanMs = 0;
+    mM2Ms = 0;
+}
+
+void DashLiveLatencyController::onRebuffer(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    mLastRebufferUs = nowUs;
+    if (mRate > 1.0f) {
+        mRate = 1.0f;
+    }
+}
+
+float DashLiveLatencyController::onLatencySample(
+        int64_t nowUs, int64_t latencyUs, int64_t bufferedUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (mTargetUs == 0) {
+        return 1.0f;
+    }
+
+    mLastLatencyUs = latencyUs;
+    ++mNumSamples;
+    double latencyMs = latencyUs / 1E3;
+    double delta = latencyMs - mMeanMs;
+    mMeanMs += delta / mNumSamples;
+    mM2Ms += delta * (latencyMs - mMeanMs);
+
+    if (!mHaveLatency) {
+        mSmoothedLatencyUs = latencyUs;
+        mHaveLatency = true;
+    } else {
+        mSmoothedLatencyUs += (latencyUs - mSmoothedLatencyUs) >> kSmoothingShift;
+    }
+
+    int64_t errorUs = mSmoothedLatencyUs - mTargetUs;
+    bool heldOff = mLastRebufferUs >= 0
+        && nowUs - mLastRebufferUs < kRebufferHoldOffUs;
+
+    float rate = mRate;
+    if (errorUs > 2 * kToleranceUs && !heldOff
+            && bufferedUs >= kMinBufferedForCatchUpUs) {
+        rate = kCatchUpRate;
+    } else if (errorUs < -2 * kToleranceUs) {
+        rate = kFallBackRate;
+    } else if ((errorUs < kToleranceUs && errorUs > -kToleranceUs)
+            || (rate > 1.0f && (heldOff || bufferedUs < kMinBufferedForCatchUpUs))) {
+        rate = 1.0f;
+    }
+
+    if (rate != mRate) {
+        ALOGV("latency %lld us (target %lld us, buffered %lld us), rate %.2f -> %.2f",
+                (long long)mSmoothedLatencyUs, (long long)mTargetUs,
+                (long long)bufferedUs, mRate, rate);
+        mRate = rate;
+    }
+    return mRate;
+}
+
+void DashLiveLatencyController::getReport(Report *report) const {
+    Mutex::Autolock autoLock(mLock);
+    report->mTargetUs = mTargetUs;
+    report->mLatencyUs = mLastLatencyUs;
+    report->mMeanUs = (int64_t)(mMeanMs * 1E3);
+    report->mVarianceMs2 =
+        mNumSamples > 1 ? (int64_t)(mM2Ms / (mNumSamples - 1)) : 0;
+    report->mRate = mRate;
+    report->mNumSamples = mNumSamples;
+}
+
+}  // namespace android
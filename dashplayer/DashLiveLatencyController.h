@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_LIVE_LATENCY_CONTROLLER_H_
+
+#define DASH_LIVE_LATENCY_CONTROLLER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Holds a live stream's playback position at a target distance from the
+// live edge by nudging the playback rate: slightly faster while too far
+// behind and enough media is buffered to afford it, slightly slower while
+// too close to the edge. Catching up is suspended for a while after the
+// source rebuffered. Also keeps the latency statistics reported with the
+// periodic QOE event. Called from the player thread, the report also from
+// binder threads.
+struct DashLiveLatencyController : public RefBase {
+    DashLiveLatencyController();
+
+    // 0 turns the controller off.
+    void setTargetLatencyUs(int64_t targetUs);
+    bool isEnabled() const;
+
+    // Forgets the latency history and returns to 1x, e.g. after a seek.
+    void reset();
+
+    void onRebuffer(int64_t nowUs);
+
+    // latencyUs is the distance of the playback position from the live
+    // edge, bufferedUs how much media past the position is already
+    // buffered. Returns the playback rate to use from now on.
+    float onLatencySample(int64_t nowUs, int64_t latencyUs, int64_t bufferedUs);
+
+    struct Report {
+        int64_t mTargetUs;
+        int64_t mLatencyUs;      // last sample, -1 if none
+        int64_t mMeanUs;
+        int64_t mVarianceMs2;    // of the samples since the last reset
+        float mRate;
+        uint32_t mNumSamples;
+    };
+    void getReport(Report *report) const;
+
+protected:
+    virtual ~DashLiveLatencyController();
+
+private:
+    mutable Mutex mLock;
+    int64_t mTargetUs;
+
+    bool mHaveLatency;
+    int64_t mSmoothedLatencyUs;
+    float mRate;
+    int64_t mLastRebufferUs;
+
+    // Welford's running mean and variance, in ms
+    int64_t mLastLatencyUs;
+    uint32_t mNumSamples;
+    double mMeanMs;
+    double mM2Ms;
+
+    DISALLOW_EVIL_CONSTRUCTORS(DashLiveLatencyController);
+};
+
+}  // namespace android
+
+#endif  // DASH_LIVE_LATENCY_CONTROLLER_H_
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashNALClassifier"
+
+#include "DashNALClassifier.h"
+
+namespace android {
+
+// AVC nal_unit_type values
+enum {
+    kAVCSliceNonIDR     = 1,
+    kAVCSliceIDR        = 5,
+    kAVCPrefix          = 14,
+};
+
+// HEVC nal_unit_type values
+enum {
+    kHEVCRsvVclN14      = 14,
+    kHEVCBlaWLp         = 16,
+    kHEVCRsvIrapVcl23   = 23,
+    kHEVCFirstNonVcl    = 32,
+};
+
+DashNALInfo::DashNALInfo()
+    : mValid(false),
+      mNALType(0),
+      mIsRandomAccess(false),
+      mIsNonReference(false),
+      mTemporalId(0) {
+}
+
+// Returns the offset of the next NAL unit header at or after *offset, and
+// moves *offset past its start code, or returns -1.
+static ssize_t FindNextNALHeader(
+        const uint8_t *data, size_t size, size_t *offset) {
+    size_t i = *offset;
+    while (i + 3 < size) {
+        if (data[i + 2] > 1) {
+            // no start code can end within the next three bytes
+            i += 3;
+        } else if (data[i] == 0x00 && data[i + 1] == 0x00
+                && data[i + 2] == 0x01) {
+            *offset = i + 3;
+            return (ssize_t)(i + 3);
+        } else {
+            ++i;
+        }
+    }
+    return -1;
+}
+
+static bool ClassifyAVC(const uint8_t *data, size_t size, DashNALInfo *info) {
+    size_t offset = 0;
+    int prefixTemporalId = -1;
+    ssize_t header;
+    while ((header = FindNextNALHeader(data, size, &offset)) >= 0) {
+        unsigned nalType = data[header] & 0x1f;
+
+        if (nalType == kAVCPrefix) {
+            // svc_extension_flag, then temporal_id in the third byte
+            if ((size_t)header + 4 <= size && (data[header + 1] & 0x80)) {
+                prefixTemporalId = data[header + 3] >> 5;
+            }
+            continue;
+        }
+
+        if (nalType < kAVCSliceNonIDR || nalType > kAVCSliceIDR) {
+            continue;
+        }
+
+        info->mValid = true;
+        info->mNALType = nalType;
+        info->mIsRandomAccess = (nalType == kAVCSliceIDR);
+        info->mIsNonReference = ((data[header] >> 5) & 3) == 0;
+        info->mTemporalId = prefixTemporalId >= 0 ? prefixTemporalId : 0;
+        return true;
+    }
+    return false;
+}
+
+static bool ClassifyHEVC(const uint8_t *data, size_t size, DashNALInfo *info) {
+    size_t offset = 0;
+    ssize_t header;
+    while ((header = FindNextNALHeader(data, size, &offset)) >= 0) {
+        if ((size_t)header + 2 > size) {
+            break;
+        }
+
+        unsigned nalType = (data[header] >> 1) & 0x3f;
+        if (nalType >= kHEVCFirstNonVcl) {
+            continue;
+        }
+
+        int temporalIdPlus1 = data[header + 1] & 7;
+        if (temporalIdPlus1 == 0) {
+            // forbidden value, not a NAL unit header
+            break;
+        }
+
+        info->mValid = true;
+        info->mNALType = nalType;
+        info->mIsRandomAccess =
+            nalType >= kHEVCBlaWLp && nalType <= kHEVCRsvIrapVcl23;
+        info->mIsNonReference =
+            nalType <= kHEVCRsvVclN14 && (nalType & 1) == 0;
+        info->mTemporalId = temporalIdPlus1 - 1;
+        return true;
+    }
+    return false;
+}
+
+bool ClassifyNALUnits(
+        const uint8_t *data, size_t size, DashNALInfo::Codec codec,
+        DashNALInfo *info) {
+    *info = DashNALInfo();
+    if (data == NULL) {
+        return false;
+    }
+
+    return (codec == DashNALInfo::kCodecHEVC)
+        ? ClassifyHEVC(data, size, info)
+        : ClassifyAVC(data, size, info);
+}
+
+}  // namespace android
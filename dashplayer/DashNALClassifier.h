@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_NAL_CLASSIFIER_H_
+
+#define DASH_NAL_CLASSIFIER_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <stdint.h>
+
+namespace android {
+
+// What a video access unit's NAL headers say about its use for reference.
+// Only headers are read, never slice data, and nothing is read beyond the
+// buffer.
+struct DashNALInfo {
+    enum Codec {
+        kCodecAVC,
+        kCodecHEVC,
+    };
+
+    DashNALInfo();
+
+    // Whether a slice NAL unit was found, nothing else is set otherwise.
+    bool mValid;
+
+    // nal_unit_type of the first slice.
+    unsigned mNALType;
+
+    // Random access point (AVC IDR, HEVC IRAP).
+    bool mIsRandomAccess;
+
+    // AVC: nal_ref_idc is 0, no picture references this one.
+    // HEVC: a _N type (TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N, RSV_VCL_N*),
+    // not referenced within its temporal sub-layer; higher sub-layers may
+    // still reference it.
+    bool mIsNonReference;
+
+    // AVC: from an SVC prefix NAL unit, 0 without one. HEVC: from the NAL
+    // unit header. Pictures never reference higher temporal ids, so whole
+    // sub-layers can be dropped from the top.
+    int mTemporalId;
+};
+
+// Classifies an Annex B access unit by its first slice, all slices of a
+// picture agree on the fields above.
+bool ClassifyNALUnits(
+        const uint8_t *data, size_t size, DashNALInfo::Codec codec,
+        DashNALInfo *info);
+
+}  // namespace android
+
+#endif  // DASH_NAL_CLASSIFIER_H_
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_PACKET_RING_H_
+
+#define DASH_PACKET_RING_H_
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+namespace android {
+
+// Bounded single-producer/single-consumer ring of access unit entries,
+// the lock-free part of DashPacketSource. push() is called from a single
+// producer thread, pop() and peek() from a single consumer thread, flush()
+// and the queries from any thread. Indices are free running. Entry needs
+// mTimeUs, mSize and mIsDiscontinuity, and releaseBuffer(), which drops
+// the payload of a consumed or flushed entry. Those fields stay in the
+// slot until the producer reuses it. kCapacity must be a power of two.
+//
+// Bytes of an entry are subtracted exactly once, by whoever first moves
+// mAccountedIndex past it: the consumer before taking it, or flush() for
+// everything it drops. Slots are only rewritten by the producer, inside
+// mSequence, so readers on other threads can validate what they read.
+template<typename Entry, int32_t kCapacity>
+class DashPacketRing {
+public:
+    DashPacketRing()
+        : mEntries(new Entry[kCapacity]),
+          mHead(0),
+          mTail(0),
+          mFlushIndex(0),
+          mLastDiscontinuityIndex(-1),
+          mAccountedIndex(0),
+          mBufferedBytes(0),
+          mSequence(0) {
+    }
+
+    ~DashPacketRing() {
+        delete[] mEntries;
+    }
+
+    // Producer. Returns false, queueing nothing, while the ring is full.
+    bool push(const Entry &entry) {
+        int32_t tail = mTail;
+        if (Distance(tail, android_atomic_acquire_load(&mHead)) >= kCapacity) {
+            return false;
+        }
+
+        android_atomic_add((int32_t)entry.mSize, &mBufferedBytes);
+
+        int32_t sequence = mSequence;
+        android_atomic_release_store(sequence + 1, &mSequence);
+        android_memory_barrier();
+        at(tail) = entry;
+        android_atomic_release_store(tail + 1, &mTail);
+        if (entry.mIsDiscontinuity) {
+            android_atomic_release_store(tail, &mLastDiscontinuityIndex);
+        }
+        android_atomic_release_store(sequence + 2, &mSequence);
+        return true;
+    }
+
+    // Consumer. Returns false if nothing is queued.
+    bool pop(Entry *entry) {
+        dropFlushed();
+
+        int32_t head = mHead;
+        if (head == android_atomic_acquire_load(&mTail)) {
+            return false;
+        }
+
+        accountUpTo(head + 1);
+
+        Entry &slot = at(head);
+        *entry = slot;
+        slot.releaseBuffer();
+        android_atomic_release_store(head + 1, &mHead);
+        return true;
+    }
+
+    // Consumer. Like pop(), but the entry stays queued.
+    bool peek(Entry *entry) {
+        dropFlushed();
+
+        int32_t head = mHead;
+        if (head == android_atomic_acquire_load(&mTail)) {
+            return false;
+        }
+
+        *entry = at(head);
+        return true;
+    }
+
+    // Drops everything queued so far, the consumer releases it on its next
+    // pop() or peek(). Its bytes are no longer counted from here on.
+    // Calls must not overlap.
+    void flush() {
+        int32_t tail = android_atomic_acquire_load(&mTail);
+        accountUpTo(tail);
+        android_atomic_release_store(tail, &mFlushIndex);
+    }
+
+    // Entries neither consumed nor flushed.
+    int32_t size() {
+        return Distance(android_atomic_acquire_load(&mTail), effectiveHead());
+    }
+
+    size_t bufferedBytes() {
+        int32_t bytes = android_atomic_acquire_load(&mBufferedBytes);
+        return bytes > 0 ? (size_t)bytes : 0;
+    }
+
+    // Timestamps of the first and the last access unit queued since the
+    // last discontinuity marker. Returns false if there are none, or if
+    // the last entry is a marker.
+    bool getSegmentTimes(int64_t *firstUs, int64_t *lastUs) {
+        for (;;) {
+            int32_t sequence = android_atomic_acquire_load(&mSequence);
+            if (sequence & 1) {
+                // the producer is writing a slot
+                sched_yield();
+                continue;
+            }
+
+            bool found = false;
+            int64_t first = -1;
+            int64_t last = -1;
+
+            int32_t head = effectiveHead();
+            int32_t tail = android_atomic_acquire_load(&mTail);
+            int32_t lastDiscontinuity =
+                android_atomic_acquire_load(&mLastDiscontinuityIndex);
+
+            // A consumed slot keeps its timestamp, so a head that moves on
+            // meanwhile only makes the result a little stale.
+            if (head != tail) {
+                const Entry &lastEntry = at(tail - 1);
+                if (!lastEntry.mIsDiscontinuity
+                        && Distance(tail, lastDiscontinuity) > 0) {
+                    int32_t firstIndex = head;
+                    if (Distance(lastDiscontinuity, head) >= 0) {
+                        firstIndex = lastDiscontinuity + 1;
+                    }
+                    first = at(firstIndex).mTimeUs;
+                    last = lastEntry.mTimeUs;
+                    found = true;
+                }
+            }
+
+            android_memory_barrier();
+            if (android_atomic_acquire_load(&mSequence) == sequence) {
+                *firstUs = first;
+                *lastUs = last;
+                return found;
+            }
+        }
+    }
+
+private:
+    Entry *mEntries;
+
+    // mTail is only written by the producer and mHead only by the consumer.
+    volatile int32_t mHead;
+    volatile int32_t mTail;
+
+    // Everything queued before this index has been flushed.
+    volatile int32_t mFlushIndex;
+
+    // Index of the most recent discontinuity marker, published right after
+    // mTail, so the current segment is found without walking the queue.
+    volatile int32_t mLastDiscontinuityIndex;
+
+    // Bytes of the entries before this index have been subtracted from
+    // mBufferedBytes. Never behind mHead.
+    volatile int32_t mAccountedIndex;
+    volatile int32_t mBufferedBytes;
+
+    // Odd while the producer writes a slot, see getSegmentTimes().
+    volatile int32_t mSequence;
+
+    // Distance between two free-running indices.
+    static int32_t Distance(int32_t to, int32_t from) {
+        return (int32_t)((uint32_t)to - (uint32_t)from);
+    }
+
+    Entry &at(int32_t index) {
+        return mEntries[index & (kCapacity - 1)];
+    }
+
+    // Index of the oldest entry that has not been consumed or flushed.
+    int32_t effectiveHead() {
+        int32_t head = android_atomic_acquire_load(&mHead);
+        int32_t flushIndex = android_atomic_acquire_load(&mFlushIndex);
+        if (Distance(flushIndex, head) > 0) {
+            head = flushIndex;
+        }
+        return head;
+    }
+
+    // Consumer, releases the entries flushed since the last call.
+    void dropFlushed() {
+        int32_t head = mHead;
+        int32_t flushIndex = android_atomic_acquire_load(&mFlushIndex);
+
+        if (Distance(flushIndex, head) <= 0) {
+            return;
+        }
+
+        // flush() accounted for these before publishing mFlushIndex
+        accountUpTo(flushIndex);
+
+        while (head != flushIndex) {
+            at(head).releaseBuffer();
+            ++head;
+        }
+        android_atomic_release_store(head, &mHead);
+    }
+
+    // Subtracts the bytes of the entries up to index not accounted for yet.
+    // The entries from mAccountedIndex on are not consumed, so their slots
+    // are stable; if another thread moved it first, the sum is discarded.
+    void accountUpTo(int32_t index) {
+        for (;;) {
+            int32_t accounted = android_atomic_acquire_load(&mAccountedIndex);
+            if (Distance(index, accounted) <= 0) {
+                return;
+            }
+
+            int32_t bytes = 0;
+            for (int32_t i = accounted; i != index; ++i) {
+                bytes += (int32_t)at(i).mSize;
+            }
+
+            if (android_atomic_release_cas(accounted, index, &mAccountedIndex) == 0) {
+                android_atomic_add(-bytes, &mBufferedBytes);
+                return;
+            }
+        }
+    }
+
+    DashPacketRing(const DashPacketRing &);
+    DashPacketRing &operator=(const DashPacketRing &);
+};
+
+}  // namespace android
+
+#endif  // DASH_PACKET_RING_H_
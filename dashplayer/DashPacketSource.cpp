@@ -35,6 +35,9 @@ namespace android {
 DashPacketSource::DashPacketSource(const sp<MetaData> &meta)
     : mIsAudio(false),
       mFormat(meta),
+      mWaiting(0),
+      mOverflowCount(0),
+      mOverflowBytes(0),
       mEOSResult(OK),
       mLogLevel(0) {
 
@@ -79,67 +82,123 @@ sp<MetaData> DashPacketSource::getFormat() {
     return mFormat;
 }
 
-status_t DashPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
-    buffer->clear();
+/** @brief: append an entry to the ring, spilling into mOverflow when full
+ *
+ *  @return: void
+ *
+ */
+void DashPacketSource::pushEntry(const Entry &entry) {
+    if (android_atomic_acquire_load(&mOverflowCount) == 0 && mRing.push(entry)) {
+        // Pairs with the barrier in dequeueEntry(), either the consumer
+        // sees the new entry or we see it waiting.
+        android_memory_barrier();
+        if (android_atomic_acquire_load(&mWaiting)) {
+            Mutex::Autolock autoLock(mLock);
+            mCondition.signal();
+        }
+        return;
+    }
 
     Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
-        mCondition.wait(mLock);
+    DPS_MSG_HIGH("ring full, %d entries in overflow", mOverflowCount + 1);
+    mOverflow.push_back(entry);
+    android_atomic_add((int32_t)entry.mSize, &mOverflowBytes);
+    android_atomic_inc(&mOverflowCount);
+    mCondition.signal();
+}
+
+/** @brief: take the next entry, blocking until one is queued or EOS
+ *
+ *  @return: OK if an entry was returned, the final result otherwise
+ *
+ */
+status_t DashPacketSource::dequeueEntry(Entry *entry) {
+    if (mRing.pop(entry)) {
+        return OK;
     }
 
-    if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        // The ring has to be checked first, the producer only falls back
+        // to mOverflow once the ring is full.
+        if (mRing.pop(entry)) {
+            return OK;
+        }
+
+        if (!mOverflow.empty()) {
+            *entry = *mOverflow.begin();
+            mOverflow.erase(mOverflow.begin());
+            android_atomic_dec(&mOverflowCount);
+            android_atomic_add(-(int32_t)entry->mSize, &mOverflowBytes);
+            return OK;
+        }
 
-        int32_t discontinuity;
-        if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
+        if (mEOSResult != OK) {
+            return mEOSResult;
+        }
 
-            return INFO_DISCONTINUITY;
+        android_atomic_release_store(1, &mWaiting);
+        android_memory_barrier();
+        if (mRing.size() > 0) {
+            android_atomic_release_store(0, &mWaiting);
+            continue;
         }
 
-        return OK;
+        mCondition.wait(mLock);
+        android_atomic_release_store(0, &mWaiting);
     }
+}
 
-    return mEOSResult;
+status_t DashPacketSource::onDiscontinuityDequeued(const Entry &entry) {
+    int32_t discontinuity;
+    CHECK(entry.mBuffer->meta()->findInt32("discontinuity", &discontinuity));
+
+    if (wasFormatChange(discontinuity)) {
+        Mutex::Autolock autoLock(mLock);
+        mFormat.clear();
+    }
+
+    return INFO_DISCONTINUITY;
 }
 
-status_t DashPacketSource::read(
-        MediaBuffer **out, const ReadOptions *) {
-    *out = NULL;
+status_t DashPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
+    buffer->clear();
 
-    Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
-        mCondition.wait(mLock);
+    Entry entry;
+    status_t err = dequeueEntry(&entry);
+    if (err != OK) {
+        return err;
     }
 
-    if (!mBuffers.empty()) {
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+    *buffer = entry.mBuffer;
 
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
+    if (entry.mIsDiscontinuity) {
+        return onDiscontinuityDequeued(entry);
+    }
 
-            return INFO_DISCONTINUITY;
-        } else {
-            int64_t timeUs;
-            CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+    return OK;
+}
 
-            MediaBuffer *mediaBuffer = new MediaBuffer(buffer);
+status_t DashPacketSource::read(
+        MediaBuffer **out, const ReadOptions *) {
+    *out = NULL;
 
-            mediaBuffer->meta_data()->setInt64(kKeyTime, timeUs);
+    Entry entry;
+    status_t err = dequeueEntry(&entry);
+    if (err != OK) {
+        return err;
+    }
 
-            *out = mediaBuffer;
-            return OK;
-        }
+    if (entry.mIsDiscontinuity) {
+        return onDiscontinuityDequeued(entry);
     }
 
-    return mEOSResult;
+    MediaBuffer *mediaBuffer = new MediaBuffer(entry.mBuffer);
+
+    mediaBuffer->meta_data()->setInt64(kKeyTime, entry.mTimeUs);
+
+    *out = mediaBuffer;
+    return OK;
 }
 
 bool DashPacketSource::wasFormatChange(
@@ -158,41 +217,49 @@ void DashPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
         return;
     }
 
-    int64_t timeUs;
-    CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
-    DPS_MSG_LOW("queueAccessUnit timeUs=%lld us (%.2f secs)", timeUs, (double)timeUs / 1E6);
+    Entry entry;
+    entry.mBuffer = buffer;
+    entry.mSize = buffer->size();
+    CHECK(buffer->meta()->findInt64("timeUs", &entry.mTimeUs));
+    DPS_MSG_LOW("queueAccessUnit timeUs=%lld us (%.2f secs)",
+            entry.mTimeUs, (double)entry.mTimeUs / 1E6);
 
-    Mutex::Autolock autoLock(mLock);
-    mBuffers.push_back(buffer);
-    DPS_MSG_LOW("@@@@:: DashPacketSource --> size is %d ",mBuffers.size() );
-    mCondition.signal();
+    pushEntry(entry);
+    DPS_MSG_LOW("@@@@:: DashPacketSource --> size is %d ", getQueueSize());
 }
 
 int DashPacketSource::getQueueSize() {
-    return (int)mBuffers.size();
+    return mRing.size() + android_atomic_acquire_load(&mOverflowCount);
 }
 
 void DashPacketSource::queueDiscontinuity(
         ATSParser::DiscontinuityType type,
         const sp<AMessage> &extra) {
-    Mutex::Autolock autoLock(mLock);
-
     if (type == ATSParser::DISCONTINUITY_TIME) {
         DPS_MSG_HIGH("Flushing all Access units for seek");
-        mBuffers.clear();
+
+        Mutex::Autolock autoLock(mLock);
+        mOverflow.clear();
+        android_atomic_release_store(0, &mOverflowCount);
+        android_atomic_release_store(0, &mOverflowBytes);
+        mRing.flush();
         mEOSResult = OK;
         mCondition.signal();
         return;
     }
 
-    mEOSResult = OK;
+    {
+        Mutex::Autolock autoLock(mLock);
+        mEOSResult = OK;
+    }
 
-    sp<ABuffer> buffer = new ABuffer(0);
-    buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
-    buffer->meta()->setMessage("extra", extra);
+    Entry entry;
+    entry.mBuffer = new ABuffer(0);
+    entry.mBuffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
+    entry.mBuffer->meta()->setMessage("extra", extra);
+    entry.mIsDiscontinuity = true;
 
-    mBuffers.push_back(buffer);
-    mCondition.signal();
+    pushEntry(entry);
 }
 
 void DashPacketSource::signalEOS(status_t result) {
@@ -204,8 +271,12 @@ void DashPacketSource::signalEOS(status_t result) {
 }
 
 bool DashPacketSource::hasBufferAvailable(status_t *finalResult) {
+    if (getQueueSize() > 0) {
+        return true;
+    }
+
     Mutex::Autolock autoLock(mLock);
-    if (!mBuffers.empty()) {
+    if (getQueueSize() > 0) {
         return true;
     }
 
@@ -214,50 +285,60 @@ bool DashPacketSource::hasBufferAvailable(status_t *finalResult) {
 }
 
 int64_t DashPacketSource::getBufferedDurationUs(status_t *finalResult) {
-    Mutex::Autolock autoLock(mLock);
-
-    *finalResult = mEOSResult;
-
-    if (mBuffers.empty()) {
-        return 0;
+    {
+        Mutex::Autolock autoLock(mLock);
+        *finalResult = mEOSResult;
     }
 
     int64_t time1 = -1;
     int64_t time2 = -1;
+    if (!mRing.getSegmentTimes(&time1, &time2)) {
+        time1 = time2 = -1;
+    }
 
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
-
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
-            if (time1 < 0) {
-                time1 = timeUs;
+    if (android_atomic_acquire_load(&mOverflowCount) > 0) {
+        Mutex::Autolock autoLock(mLock);
+        for (List<Entry>::iterator it = mOverflow.begin();
+                it != mOverflow.end(); ++it) {
+            if (!it->mIsDiscontinuity) {
+                if (time1 < 0) {
+                    time1 = it->mTimeUs;
+                }
+
+                time2 = it->mTimeUs;
+            } else {
+                // This is a discontinuity, reset everything.
+                time1 = time2 = -1;
             }
-
-            time2 = timeUs;
-        } else {
-            // This is a discontinuity, reset everything.
-            time1 = time2 = -1;
         }
-
-        ++it;
     }
 
     return time2 - time1;
 }
 
+size_t DashPacketSource::getBufferedBytes() {
+    int32_t overflowBytes = android_atomic_acquire_load(&mOverflowBytes);
+    return mRing.bufferedBytes() + (overflowBytes > 0 ? (size_t)overflowBytes : 0);
+}
+
 status_t DashPacketSource::nextBufferTime(int64_t *timeUs) {
     *timeUs = 0;
 
-    Mutex::Autolock autoLock(mLock);
+    Entry entry;
+    if (!mRing.peek(&entry)) {
+        Mutex::Autolock autoLock(mLock);
+
+        if (!mRing.peek(&entry)) {
+            if (mOverflow.empty()) {
+                return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
+            }
 
-    if (mBuffers.empty()) {
-        return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
+            entry = *mOverflow.begin();
+        }
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
-    CHECK(buffer->meta()->findInt64("timeUs", timeUs));
+    CHECK(!entry.mIsDiscontinuity);
+    *timeUs = entry.mTimeUs;
     return OK;
 }
 
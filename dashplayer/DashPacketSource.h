@@ -25,12 +25,20 @@
 #include <media/stagefright/MediaSource.h>
 #include <utils/threads.h>
 #include <utils/List.h>
+#include <cutils/atomic.h>
 #include "ATSParser.h"
+#include "DashPacketRing.h"
 
 namespace android {
 
 struct ABuffer;
 
+// Access units are handed from the streaming source to DashPlayer through
+// a bounded single-producer/single-consumer ring (DashPacketRing), so
+// neither side takes mLock on the per-AU path. queueAccessUnit() and format discontinuities
+// must come from a single producer thread; dequeueAccessUnit(), read() and
+// nextBufferTime() from a single consumer thread. Time discontinuities,
+// signalEOS() and the query functions are safe from any thread.
 struct DashPacketSource : public MediaSource {
     DashPacketSource(const sp<MetaData> &meta);
 
@@ -49,6 +57,9 @@ struct DashPacketSource : public MediaSource {
     // presentation timestamps since the last discontinuity (if any).
     int64_t getBufferedDurationUs(status_t *finalResult);
 
+    // Returns the payload size of all queued access units in bytes.
+    size_t getBufferedBytes();
+
     status_t nextBufferTime(int64_t *timeUs);
 
     void queueAccessUnit(const sp<ABuffer> &buffer);
@@ -67,17 +78,50 @@ protected:
     virtual ~DashPacketSource();
 
 private:
+    enum {
+        // Must be a power of two.
+        kRingCapacity = 1024,
+    };
+
+    struct Entry {
+        Entry() : mTimeUs(-1), mSize(0), mIsDiscontinuity(false) {}
+
+        void releaseBuffer() { mBuffer.clear(); }
+
+        sp<ABuffer> mBuffer;
+        int64_t mTimeUs;
+        size_t mSize;
+        bool mIsDiscontinuity;
+    };
+
     Mutex mLock;
     Condition mCondition;
 
     bool mIsAudio;
     sp<MetaData> mFormat;
-    List<sp<ABuffer> > mBuffers;
+
+    // A time discontinuity flushes it, the consumer releases the flushed
+    // entries on its next dequeue.
+    DashPacketRing<Entry, kRingCapacity> mRing;
+
+    // Set while the consumer is blocked on mCondition.
+    volatile int32_t mWaiting;
+
+    // Protected by mLock. Only used when the ring is full, entries in here
+    // always come after everything still in the ring.
+    List<Entry> mOverflow;
+    volatile int32_t mOverflowCount;
+    volatile int32_t mOverflowBytes;
+
     status_t mEOSResult;
     int mLogLevel;
 
     bool wasFormatChange(int32_t discontinuityType) const;
 
+    void pushEntry(const Entry &entry);
+    status_t dequeueEntry(Entry *entry);
+    status_t onDiscontinuityDequeued(const Entry &entry);
+
     DISALLOW_EVIL_CONSTRUCTORS(DashPacketSource);
 };
 
@@ -25,6 +25,7 @@
 #include <utils/Log.h>
 #include <dlfcn.h>  // for dlopen/dlclose
 #include "DashPlayer.h"
+#include "DashPlayerCaptionExtractor.h"
 #include "DashPlayerDecoder.h"
 #include "DashPlayerDriver.h"
 #include "DashPlayerRenderer.h"
@@ -33,13 +34,13 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
 #include <gui/IGraphicBufferProducer.h>
 #include "avc_utils.h"
 #include "OMX_QCOMExtns.h"
 #include <gralloc_priv.h>
 #include <cutils/properties.h>
 #include <utils/Log.h>
-#include <media/msm_media_info.h>
 
 #define DP_MSG_ERROR(...) ALOGE(__VA_ARGS__)
 #define DP_MSG_HIGH(...) if(mLogLevel >= 1){ALOGE(__VA_ARGS__);}
@@ -113,6 +114,7 @@ private:
 DashPlayer::DashPlayer()
     : mUIDValid(false),
       mVideoIsAVC(false),
+      mVideoIsHEVC(false),
       mRenderer(NULL),
       mAudioEOS(false),
       mVideoEOS(false),
@@ -128,13 +130,43 @@ DashPlayer::DashPlayer()
       mSetVideoSize(true),
       mSkipRenderingAudioUntilMediaTimeUs(-1ll),
       mSkipRenderingVideoUntilMediaTimeUs(-1ll),
+      mAudioPCMSampleRate(0),
+      mAudioPCMFrameSize(0),
       mVideoLateByUs(0ll),
       mPauseIndication(false),
+      mUseRendererLooper(false),
+      mOffloadAudio(false),
+      mAudioPathSwitchPending(false),
+      mAudioReplayPending(false),
+      mAudioPathSwitchDeferred(false),
+      mPlaybackRate(1.0f),
+      mLiveController(new DashLiveLatencyController),
+      mLiveRate(1.0f),
+      mLastLiveUpdateUs(-1ll),
+      mMaxQueuedTimeUs(-1ll),
+      mMaxPooledDecoders(2),
+      mDecoderReleasePending(false),
+      mAudioReinitStartUs(-1ll),
+      mVideoReinitStartUs(-1ll),
+      mAudioReinitWarm(false),
+      mVideoReinitWarm(false),
+      mPrerollDecoders(true),
+      mReplayingHeldNotifies(false),
+      mAudioSwitchedAtBoundary(false),
+      mSeekMode(SEEK_EXACT),
+      mPendingSeekMode(SEEK_EXACT),
+      mVideoSeekState(VIDEO_SEEK_NONE),
+      mSeekTargetUs(-1ll),
+      mSeekRenderFromUs(-1ll),
+      mSeekAwaitingOutput(false),
+      mLastVideoSyncTimeUs(-1ll),
+      mVideoSyncIntervalUs(0),
       mSRid(0),
       mStats(NULL),
       mLogLevel(0),
       mTimedTextCEAPresent(false),
       mTimedTextCEASamplesDisc(false),
+      mCaptionGeneration(0),
       mQCTimedTextListenerPresent(false),
       mCurrentWidth(0),
       mCurrentHeight(0),
@@ -148,12 +180,58 @@ DashPlayer::DashPlayer()
           mLogLevel = atoi(property_value);
       }
 
+      property_value[0] = '\0';
+      property_get("persist.dash.player.threads", property_value, NULL);
+      if(*property_value) {
+          mUseRendererLooper = atoi(property_value) != 0;
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.audio.offload", property_value, NULL);
+      if(*property_value) {
+          mOffloadAudio = atoi(property_value) != 0;
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.live.target.ms", property_value, NULL);
+      if(*property_value && atoi(property_value) > 0) {
+          mLiveController->setTargetLatencyUs(atoi(property_value) * 1000ll);
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.decoder.pool", property_value, NULL);
+      if(*property_value && atoi(property_value) >= 0) {
+          mMaxPooledDecoders = atoi(property_value);
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.decoder.preroll", property_value, NULL);
+      if(*property_value) {
+          mPrerollDecoders = atoi(property_value) != 0;
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.seek.mode", property_value, NULL);
+      if(*property_value) {
+          int mode = atoi(property_value);
+          if (mode >= SEEK_PREVIOUS_SYNC && mode <= SEEK_EXACT) {
+              mSeekMode = mode;
+          }
+      }
+
 }
 
 DashPlayer::~DashPlayer() {
     if (mRenderer != NULL) {
         looper()->unregisterHandler(mRenderer->id());
     }
+    if (mRendererLooper != NULL) {
+        mRendererLooper->stop();
+        mRendererLooper.clear();
+    }
+    if (mCaptionExtractor != NULL) {
+        looper()->unregisterHandler(mCaptionExtractor->id());
+    }
     if (mAudioDecoder != NULL) {
       looper()->unregisterHandler(mAudioDecoder->id());
     }
@@ -163,6 +241,15 @@ DashPlayer::~DashPlayer() {
     if (mTextDecoder != NULL) {
       looper()->unregisterHandler(mTextDecoder->id());
     }
+    for (size_t i = 0; i < mDecoderPool.size(); ++i) {
+      looper()->unregisterHandler(mDecoderPool[i].mDecoder->id());
+    }
+    for (size_t i = 0; i < mRetiredDecoders.size(); ++i) {
+      looper()->unregisterHandler(mRetiredDecoders[i]->id());
+    }
+    if (mAudioOutgoingDecoder != NULL) {
+      looper()->unregisterHandler(mAudioOutgoingDecoder->id());
+    }
     if(mStats != NULL) {
         mStats->logFpsSummary();
         mStats = NULL;
@@ -251,6 +338,17 @@ void DashPlayer::resume() {
     (new AMessage(kWhatResume, id()))->post();
 }
 
+status_t DashPlayer::setPlaybackRate(float rate) {
+    if (rate < 0.5f || rate > 2.0f) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatSetPlaybackRate, id());
+    msg->setFloat("rate", rate);
+    msg->post();
+    return OK;
+}
+
 void DashPlayer::resetAsync() {
     (new AMessage(kWhatReset, id()))->post();
 }
@@ -261,6 +359,17 @@ void DashPlayer::seekToAsync(int64_t seekTimeUs) {
     msg->post();
 }
 
+status_t DashPlayer::setSeekMode(int32_t mode) {
+    if (mode < SEEK_PREVIOUS_SYNC || mode > SEEK_EXACT) {
+        return BAD_VALUE;
+    }
+
+    sp<AMessage> msg = new AMessage(kWhatSetSeekMode, id());
+    msg->setInt32("mode", mode);
+    msg->post();
+    return OK;
+}
+
 // static
 bool DashPlayer::IsFlushingState(FlushStatus state, bool *needShutdown) {
     switch (state) {
@@ -282,6 +391,27 @@ bool DashPlayer::IsFlushingState(FlushStatus state, bool *needShutdown) {
     }
 }
 
+// static
+bool DashPlayer::TrimPCMBuffer(
+        const sp<ABuffer> &buffer, int64_t *timeUs, int64_t untilUs,
+        uint32_t sampleRate, size_t frameSize) {
+    if (sampleRate == 0 || frameSize == 0 || untilUs <= *timeUs) {
+        return true;
+    }
+
+    // rounded down, never skips a frame at or after untilUs
+    size_t numFrames = (size_t)((untilUs - *timeUs) * sampleRate / 1000000ll);
+    if (numFrames >= buffer->size() / frameSize) {
+        return false;
+    }
+
+    size_t numBytes = numFrames * frameSize;
+    // The decoder sets the range again before the buffer is reused.
+    buffer->setRange(buffer->offset() + numBytes, buffer->size() - numBytes);
+    *timeUs += (int64_t)numFrames * 1000000ll / sampleRate;
+    return true;
+}
+
 void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatSetDataSource:
@@ -324,6 +454,7 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             sp<RefBase> obj;
             CHECK(msg->findObject("native-window", &obj));
 
+            purgeDecoderPool();
             mNativeWindow = static_cast<NativeWindowWrapper *>(obj.get());
               DP_MSG_ERROR("kWhatSetVideoNativeWindow valid nativewindow  %p", mNativeWindow.get());
               if (mDriver != NULL) {
@@ -406,7 +537,27 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             // for qualcomm statistics profiling
             mStats = new DashPlayerStats();
             mRenderer->registerStats(mStats);
-            looper()->registerHandler(mRenderer);
+            mDropController = new DashFrameDropController;
+            mRenderer->setFrameDropController(mDropController);
+            mLiveRate = 1.0f;
+            mLastLiveUpdateUs = -1ll;
+            mMaxQueuedTimeUs = -1ll;
+            mLiveController->reset();
+            if (mUseRendererLooper) {
+                if (mRendererLooper == NULL) {
+                    mRendererLooper = new ALooper;
+                    mRendererLooper->setName("DashPlayerRenderer");
+                    mRendererLooper->start(false, false, ANDROID_PRIORITY_AUDIO);
+                }
+                mRendererLooper->registerHandler(mRenderer);
+            } else {
+                looper()->registerHandler(mRenderer);
+            }
+
+            // posts to the renderer, so only once it has an id
+            if (mPlaybackRate != 1.0f) {
+                applyPlaybackRate();
+            }
 
             postScanSources();
             break;
@@ -440,7 +591,7 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                     instantiateDecoder(kVideo, &mVideoDecoder);
                 }
 
-                if (mAudioSink != NULL) {
+                if (mAudioSink != NULL && !mAudioPathSwitchPending) {
                     instantiateDecoder(kAudio, &mAudioDecoder);
                 }
 
@@ -470,6 +621,7 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 if (mTimeDiscontinuityPending && mRenderer != NULL){
                     mRenderer->signalTimeDiscontinuity();
                     mTimeDiscontinuityPending = false;
+                    resetLiveLatency();
                 }
             }
             break;
@@ -503,6 +655,10 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
               CHECK(msg->findInt32("what", &what));
             }
 
+            if (track == kAudio && routeSwitchingNotify(what, msg)) {
+                break;
+            }
+
             if (what == Decoder::kWhatFillThisBuffer) {
                 DP_MSG_LOW("@@@@:: Dashplayer :: MESSAGE FROM CODEC +++++++++++++ (%s) kWhatFillThisBuffer",mTrackName);
                 if ( (track == kText) && (mTextDecoder == NULL)) {
@@ -557,7 +713,11 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
                 if(mRenderer != NULL)
                 {
-                  if((track == kAudio && !IsFlushingState(mFlushingAudio)) || (track == kVideo && !IsFlushingState(mFlushingVideo))) {
+                  if (track == kAudio && mAudioPathSwitchPending) {
+                    // the offloading decoder being replaced, the source
+                    // reports EOS again to the next one
+                    DP_MSG_HIGH("audio path switch pending, decoder EOS not queued to renderer");
+                  } else if((track == kAudio && !IsFlushingState(mFlushingAudio)) || (track == kVideo && !IsFlushingState(mFlushingVideo))) {
                     mRenderer->queueEOS(track, err);
                   }
                   else{
@@ -586,11 +746,25 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                     DP_MSG_HIGH("initiating %s decoder shutdown",
                            mTrackName);
 
+                    // After a format change the next decoder is instantiated
+                    // right away and may be able to start this one again.
+                    bool park = mMaxPooledDecoders > 0
+                        && !mResetInProgress && !mResetPostponed
+                        && (track == kAudio ? mAudioReinitStartUs : mVideoReinitStartUs) >= 0;
+
                     if (track == kAudio) {
-                        mAudioDecoder->initiateShutdown();
+                        if (park) {
+                            mAudioDecoder->initiateParking();
+                        } else {
+                            mAudioDecoder->initiateShutdown();
+                        }
                         mFlushingAudio = SHUTTING_DOWN_DECODER;
                     } else if (track == kVideo) {
-                        mVideoDecoder->initiateShutdown();
+                        if (park) {
+                            mVideoDecoder->initiateParking();
+                        } else {
+                            mVideoDecoder->initiateShutdown();
+                        }
                         mFlushingVideo = SHUTTING_DOWN_DECODER;
                     }
                 }
@@ -610,6 +784,22 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
 
                     DP_MSG_HIGH("Audio output format changed to %d Hz, %d channels",
                          sampleRate, numChannels);
+
+                    if (mReplayingHeldNotifies) {
+                        // first output of a decoder switched to at a format
+                        // change, the sink may still play the outgoing tail
+                        if ((uint32_t)sampleRate == mAudioPCMSampleRate
+                                && numChannels * sizeof(int16_t) == mAudioPCMFrameSize) {
+                            DP_MSG_HIGH("keeping the audio sink across the decoder switch");
+                            break;
+                        }
+                        if (mRenderer != NULL) {
+                            mRenderer->flush(true /* audio */);
+                        }
+                    }
+
+                    mAudioPCMSampleRate = sampleRate;
+                    mAudioPCMFrameSize = numChannels * sizeof(int16_t);
                     if (mAudioSink != NULL)
                     {
                       mAudioSink->close();
@@ -645,8 +835,8 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                                 (audio_channel_mask_t)channelMask,
                                 AUDIO_FORMAT_PCM_16_BIT,
                                 8 /* bufferCount */,
-                                NULL,
-                                NULL,
+                                mRenderer != NULL ? mRenderer->getAudioSinkCallback() : NULL,
+                                mRenderer.get(),
                                 flags),
                              (status_t)OK);
                     mAudioSink->start();
@@ -668,6 +858,53 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             } else if (what == Decoder::kWhatShutdownCompleted) {
                 DP_MSG_ERROR("%s shutdown completed", mTrackName);
 
+                int32_t parked = 0;
+                msg->findInt32("parked", &parked);
+
+                int32_t retired;
+                if (msg->findInt32("retired", &retired) && retired) {
+                    // an evicted pooled or switched away from decoder,
+                    // not the current one
+                    sp<RefBase> obj;
+                    CHECK(msg->findObject("decoder", &obj));
+                    for (size_t i = 0; i < mRetiredDecoders.size(); ++i) {
+                        sp<Decoder> decoder = mRetiredDecoders[i];
+                        if (decoder.get() == static_cast<Decoder *>(obj.get())) {
+                            mRetiredDecoders.removeAt(i);
+                            if (parked) {
+                                parkDecoder(decoder);
+                            } else {
+                                looper()->unregisterHandler(decoder->id());
+                            }
+                            break;
+                        }
+                    }
+                    if (mDecoderReleasePending && mFlushingAudio == NONE
+                            && mFlushingVideo == NONE) {
+                        // a decoder creation waits for this component
+                        mDecoderReleasePending = false;
+                        postScanSources();
+                    }
+                    return;
+                }
+
+                if (track == kAudio && mAudioPathSwitchPending) {
+                    if (mFlushingAudio == NONE) {
+                        if (mAudioDecoder != NULL) {
+                            looper()->unregisterHandler(mAudioDecoder->id());
+                        }
+                        mAudioDecoder.clear();
+
+                        if (!mAudioReplayPending) {
+                            finishAudioPathSwitch();
+                        }
+                        return;
+                    }
+
+                    // a flush came in meanwhile, it brings the decoder back
+                    cancelAudioPathSwitch();
+                }
+
                 if((track == kAudio && mFlushingAudio == SHUT_DOWN)
                   || (track == kVideo && mFlushingVideo == SHUT_DOWN))
                 {
@@ -677,7 +914,11 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 if (track == kAudio) {
                     DP_MSG_ERROR("@@@@:: Dashplayer :: MESSAGE FROM CODEC +++++++++++++++++++++++++++++++ kWhatShutdownCompleted:: audio");
                     if (mAudioDecoder != NULL) {
-                        looper()->unregisterHandler(mAudioDecoder->id());
+                        if (parked) {
+                            parkDecoder(mAudioDecoder);
+                        } else {
+                            looper()->unregisterHandler(mAudioDecoder->id());
+                        }
                     }
                     mAudioDecoder.clear();
 
@@ -685,7 +926,11 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 } else if (track == kVideo) {
                     DP_MSG_ERROR("@@@@:: Dashplayer :: MESSAGE FROM CODEC +++++++++++++++++++++++++++++++ kWhatShutdownCompleted:: Video");
                     if (mVideoDecoder != NULL) {
-                        looper()->unregisterHandler(mVideoDecoder->id());
+                        if (parked) {
+                            parkDecoder(mVideoDecoder);
+                        } else {
+                            looper()->unregisterHandler(mVideoDecoder->id());
+                        }
                     }
                     mVideoDecoder.clear();
 
@@ -717,6 +962,28 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             } else if (what == Decoder::kWhatDrainThisBuffer) {
                 if(track == kAudio || track == kVideo) {
                    DP_MSG_LOW("@@@@:: Dashplayer :: MESSAGE FROM CODEC +++++++++++++++++++++++++++++++ Codec::kWhatRenderBuffer:: %s",track == kAudio ? "audio" : "video");
+                        // the first output of the decoder that followed a
+                        // format change, not one queued before the flush
+                        int64_t *reinitStartUs =
+                            (track == kAudio) ? &mAudioReinitStartUs : &mVideoReinitStartUs;
+                        if (*reinitStartUs >= 0
+                                && (track == kAudio ? mFlushingAudio : mFlushingVideo) == NONE) {
+                            bool warm = (track == kAudio) ? mAudioReinitWarm : mVideoReinitWarm;
+                            int64_t latencyUs = ALooper::GetNowUs() - *reinitStartUs;
+                            DP_MSG_HIGH("%s decoder re-init took %lld us (%s)",
+                                    mTrackName, (long long)latencyUs, warm ? "warm" : "cold");
+                            if (mStats != NULL) {
+                                mStats->recordDecoderReinit(latencyUs, warm);
+                            }
+                            *reinitStartUs = -1;
+                        }
+                        if (track == kVideo && mSeekAwaitingOutput
+                                && mFlushingVideo == NONE) {
+                            if (mStats != NULL) {
+                                mStats->markSeekStage(DashPlayerStats::kSeekStageOutput);
+                            }
+                            mSeekAwaitingOutput = false;
+                        }
                         renderBuffer(track, msg);
                     }
             } else {
@@ -726,6 +993,35 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatCaptionNotify:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+            if (generation != mCaptionGeneration) {
+                // extracted from a frame decoded before the last flush
+                break;
+            }
+
+            sp<ABuffer> accessUnit;
+            CHECK(msg->findBuffer("buffer", &accessUnit));
+
+            //To signal discontinuity in samples during seek and resume-out-of-tsb(internal seek) operations
+            if(mTimedTextCEASamplesDisc)
+            {
+              accessUnit->meta()->setInt32("disc", 1);
+              mTimedTextCEASamplesDisc = false;
+            }
+
+            //Indicate timedtext CEA present in stream. Used to signal EOS in Codec::kWhatEOS
+            if(!mTimedTextCEAPresent)
+            {
+              mTimedTextCEAPresent = true;
+            }
+
+            sendTextPacket(accessUnit, OK, TIMED_TEXT_CEA);
+            break;
+        }
+
         case kWhatRendererNotify:
         {
             int32_t what;
@@ -778,6 +1074,41 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                         mSource->notifyRenderingPosition(positionUs);
                     }
                 }
+                updateLiveLatency(positionUs);
+            } else if (what == Renderer::kWhatAudioOffloadTearDown) {
+                DP_MSG_ERROR("audio offload torn down, switching to decoding");
+                mOffloadAudio = false;
+
+                Mutex::Autolock autoLock(mLock);
+                switchAudioPath();
+            } else if (what == Renderer::kWhatAudioOffloadEnded) {
+                int64_t resumeUs;
+                CHECK(msg->findInt64("resumeUs", &resumeUs));
+                sp<RefBase> obj;
+                CHECK(msg->findObject("replay", &obj));
+                sp<Renderer::AudioReplay> replay =
+                    static_cast<Renderer::AudioReplay *>(obj.get());
+
+                Mutex::Autolock autoLock(mLock);
+                if (mAudioReplayPending) {
+                    mAudioReplayPending = false;
+
+                    if (mFlushingAudio != NONE) {
+                        // a flush came in meanwhile, nothing to resume
+                        cancelAudioPathSwitch();
+                    } else {
+                        // ahead of the access units the renderer never got
+                        mAudioReplay.insert(mAudioReplay.begin(),
+                                replay->mAccessUnits.begin(), replay->mAccessUnits.end());
+                        if (resumeUs >= 0) {
+                            mSkipRenderingAudioUntilMediaTimeUs = resumeUs;
+                        }
+
+                        if (mAudioDecoder == NULL) {
+                            finishAudioPathSwitch();
+                        }
+                    }
+                }
             } else if (what == Renderer::kWhatFlushComplete) {
                 CHECK_EQ(what, (int32_t)Renderer::kWhatFlushComplete);
 
@@ -853,13 +1184,24 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
               break;
             }
 
-            DP_MSG_ERROR("kWhatSeek seekTimeUs=%lld us (%.2f secs)",
-                 seekTimeUs, (double)seekTimeUs / 1E6);
+            DP_MSG_ERROR("kWhatSeek seekTimeUs=%lld us (%.2f secs) mode %d",
+                 seekTimeUs, (double)seekTimeUs / 1E6, mSeekMode);
+
+            mVideoSeekState = VIDEO_SEEK_NONE;
+            mSeekRenderFromUs = -1;
+            mSeekAwaitingOutput = false;
 
             nRet = mSource->seekTo(seekTimeUs);
 
+            if(mStats != NULL) {
+                mStats->markSeekStage(DashPlayerStats::kSeekStageSource);
+            }
+
             if (nRet == OK) { // if seek success then flush the audio,video decoder and renderer
                 mTimeDiscontinuityPending = true;
+                mSeekTargetUs = seekTimeUs;
+                mPendingSeekMode = mSeekMode;
+                mLastVideoSyncTimeUs = -1;
                 bool audPresence = false;
                 bool vidPresence = false;
                 bool textPresence = false;
@@ -884,6 +1226,14 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                     DP_MSG_LOW("Video is not there, set it to shutdown");
                     mFlushingVideo = SHUT_DOWN;
                 }
+
+                // without video there are no sync samples to choose from
+                if (vidPresence) {
+                    mVideoSeekState = VIDEO_SEEK_AWAITING_FIRST;
+                } else {
+                    mSeekRenderFromUs = seekTimeUs;
+                    mSkipRenderingAudioUntilMediaTimeUs = seekTimeUs;
+                }
             }
             else if (nRet != PERMISSION_DENIED) {
                 mTimeDiscontinuityPending = true;
@@ -913,6 +1263,21 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetPlaybackRate:
+        {
+            CHECK(msg->findFloat("rate", &mPlaybackRate));
+            DP_MSG_HIGH("kWhatSetPlaybackRate %.3f", mPlaybackRate);
+            applyPlaybackRate();
+            break;
+        }
+
+        case kWhatSetSeekMode:
+        {
+            CHECK(msg->findInt32("mode", &mSeekMode));
+            DP_MSG_HIGH("kWhatSetSeekMode %d", mSeekMode);
+            break;
+        }
+
         case kWhatPause:
         {
             DP_MSG_ERROR("kWhatPause");
@@ -1101,6 +1466,7 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                           {
                               mBufferingNotification = true;
                               notifyListener(MEDIA_INFO, MEDIA_INFO_BUFFERING_START, 0);
+                              mLiveController->onRebuffer(ALooper::GetNowUs());
                           }
                       }
                       else {
@@ -1240,10 +1606,15 @@ void DashPlayer::finishFlushIfPossible() {
 
     DP_MSG_HIGH("both audio and video are flushed now.");
 
+    if (mStats != NULL) {
+        mStats->markSeekStage(DashPlayerStats::kSeekStageFlush);
+    }
+
     if ((mRenderer != NULL) && (mTimeDiscontinuityPending) &&
          !isSetSurfaceTexturePending) {
         mRenderer->signalTimeDiscontinuity();
         mTimeDiscontinuityPending = false;
+        resetLiveLatency();
     }
 
     if (mAudioDecoder != NULL) {
@@ -1258,6 +1629,20 @@ void DashPlayer::finishFlushIfPossible() {
 
     mFlushingAudio = NONE;
     mFlushingVideo = NONE;
+    mAudioSwitchedAtBoundary = false;
+
+    // fill requests parked by a decoder switched at the boundary
+    while (!mAudioParkedFillRequests.empty()) {
+        if (!mResetInProgress && !mResetPostponed) {
+            (*mAudioParkedFillRequests.begin())->post();
+        }
+        mAudioParkedFillRequests.erase(mAudioParkedFillRequests.begin());
+    }
+
+    if (mAudioPathSwitchDeferred) {
+        mAudioPathSwitchDeferred = false;
+        switchAudioPath();
+    }
 
     if (mResetInProgress) {
         DP_MSG_ERROR("reset completed");
@@ -1294,6 +1679,16 @@ void DashPlayer::finishReset() {
     CHECK(mAudioDecoder == NULL);
     CHECK(mVideoDecoder == NULL);
 
+    purgeDecoderPool();
+    mDecoderReleasePending = false;
+    mAudioReinitStartUs = -1;
+    mVideoReinitStartUs = -1;
+    mVideoSeekState = VIDEO_SEEK_NONE;
+    mSeekRenderFromUs = -1;
+    mSeekAwaitingOutput = false;
+    cancelAudioPathSwitch();
+    mAudioPathSwitchDeferred = false;
+
     ++mScanSourcesGeneration;
     mScanSourcesPending = false;
 
@@ -1302,6 +1697,16 @@ void DashPlayer::finishReset() {
         mRenderer.clear();
     }
 
+    if (mRendererLooper != NULL) {
+        mRendererLooper->stop();
+        mRendererLooper.clear();
+    }
+
+    if (mCaptionExtractor != NULL) {
+        looper()->unregisterHandler(mCaptionExtractor->id());
+        mCaptionExtractor.clear();
+    }
+
     if (mSource != NULL) {
         DP_MSG_ERROR("finishReset calling mSource->stop");
         mSource->stop();
@@ -1352,7 +1757,7 @@ void DashPlayer::postScanSources() {
     mScanSourcesPending = true;
 }
 
-status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder) {
+status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder, bool preroll) {
     DP_MSG_LOW("@@@@:: instantiateDecoder Called ");
     if (*decoder != NULL) {
         return OK;
@@ -1373,9 +1778,13 @@ status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder) {
         const char *mime = NULL;
         CHECK(meta->findCString(kKeyMIMEType, &mime));
         mVideoIsAVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_AVC, mime);
+        mVideoIsHEVC = !strcasecmp(MEDIA_MIMETYPE_VIDEO_HEVC, mime);
         if(mStats != NULL) {
             mStats->setMime(mime);
         }
+        if (mDropController != NULL) {
+            mDropController->setMime(mime);
+        }
 
         if (mSetVideoSize) {
             int32_t width = 0;
@@ -1388,20 +1797,57 @@ status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder) {
         }
     }
 
+    if ((track == kAudio || track == kVideo) && !preroll
+            && releasePooledDecoders(track, Decoder::GetPoolKey(meta))) {
+        DP_MSG_HIGH("%s decoder waits for parked components to be released",
+                track == kAudio ? "audio" : "video");
+        mDecoderReleasePending = true;
+        return -EWOULDBLOCK;
+    }
+
     sp<AMessage> notify;
+    sp<Decoder> pooled;
+    bool offload = false;
     if (track == kAudio) {
         notify = new AMessage(kWhatAudioNotify ,id());
-        DP_MSG_HIGH("Creating Audio Decoder ");
-        *decoder = new Decoder(notify);
         DP_MSG_LOW("@@@@:: setting Sink/Renderer pointer to decoder");
-         if (mRenderer != NULL) {
+         if (mRenderer != NULL && !preroll) {
             mRenderer->setMediaPresence(true,true);
+            mAudioPCMSampleRate = 0;
+            mAudioPCMFrameSize = 0;
+
+            // Only audio-only or background playback is offloaded, the
+            // decoder path stays the fallback if the sink refuses.
+            offload = mOffloadAudio && mNativeWindow == NULL
+                && mPlaybackRate == 1.0f && !mLiveController->isEnabled()
+                && openAudioSinkForOffload(meta) == OK;
+            mRenderer->setAudioOffload(offload);
+            mAudioPathSwitchDeferred = false;
+        }
+
+        if (!offload) {
+            pooled = takePooledDecoder(Decoder::GetPoolKey(meta));
         }
+        if (pooled != NULL) {
+            DP_MSG_HIGH("Reusing pooled Audio Decoder ");
+            *decoder = pooled;
+        } else {
+            DP_MSG_HIGH("Creating Audio Decoder ");
+            *decoder = new Decoder(notify);
+        }
+        mAudioReinitWarm = pooled != NULL;
     } else if (track == kVideo) {
         notify = new AMessage(kWhatVideoNotify ,id());
-        *decoder = new Decoder(notify, mNativeWindow);
-        DP_MSG_HIGH("Creating Video Decoder ");
-        if (mRenderer != NULL) {
+        pooled = takePooledDecoder(Decoder::GetPoolKey(meta));
+        if (pooled != NULL) {
+            DP_MSG_HIGH("Reusing pooled Video Decoder ");
+            *decoder = pooled;
+        } else {
+            *decoder = new Decoder(notify, mNativeWindow);
+            DP_MSG_HIGH("Creating Video Decoder ");
+        }
+        mVideoReinitWarm = pooled != NULL;
+        if (mRenderer != NULL && !preroll) {
             mRenderer->setMediaPresence(false,true);
         }
     } else if (track == kText) {
@@ -1431,8 +1877,16 @@ status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder) {
     }
 
     if( (track == kAudio || track == kVideo) && ((*decoder) != NULL)) {
-        (*decoder)->init();
-        (*decoder)->configure(meta);
+        // a pooled decoder is still registered, and still carries its id
+        if (pooled == NULL) {
+            (*decoder)->init();
+            notify->setInt32("decoder-id", (*decoder)->id());
+        }
+        if (offload) {
+            (*decoder)->configureForOffload(meta);
+        } else {
+            (*decoder)->configure(meta);
+        }
     }
 
     int64_t durationUs;
@@ -1446,6 +1900,75 @@ status_t DashPlayer::instantiateDecoder(int track, sp<Decoder> *decoder) {
     return OK;
 }
 
+status_t DashPlayer::openAudioSinkForOffload(const sp<MetaData> &meta) {
+    const char *mime;
+    CHECK(meta->findCString(kKeyMIMEType, &mime));
+    if (strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AAC)
+            || mRenderer->getAudioSinkCallback() == NULL) {
+        return INVALID_OPERATION;
+    }
+
+    if (!canOffloadStream(meta, false /* hasVideo */,
+                true /* isStreaming */, AUDIO_STREAM_MUSIC)) {
+        DP_MSG_HIGH("audio offload not supported for this stream");
+        return INVALID_OPERATION;
+    }
+
+    audio_format_t format;
+    if (mapMimeToAudioFormat(format, mime) != OK) {
+        return INVALID_OPERATION;
+    }
+
+    int32_t sampleRate;
+    int32_t numChannels;
+    if (!meta->findInt32(kKeySampleRate, &sampleRate)
+            || !meta->findInt32(kKeyChannelCount, &numChannels)) {
+        return INVALID_OPERATION;
+    }
+
+    int32_t bitRate = 0;
+    meta->findInt32(kKeyBitRate, &bitRate);
+    int64_t durationUs = -1;
+    mSource->getDuration(&durationUs);
+
+    audio_offload_info_t offloadInfo = AUDIO_INFO_INITIALIZER;
+    offloadInfo.sample_rate = sampleRate;
+    offloadInfo.channel_mask = audio_channel_out_mask_from_count(numChannels);
+    offloadInfo.format = format;
+    offloadInfo.stream_type = AUDIO_STREAM_MUSIC;
+    offloadInfo.bit_rate = bitRate;
+    offloadInfo.duration_us = durationUs;
+    offloadInfo.has_video = false;
+    offloadInfo.is_streaming = true;
+
+    mAudioSink->close();
+
+    status_t err = mAudioSink->open(
+            sampleRate,
+            numChannels,
+            offloadInfo.channel_mask,
+            format,
+            0 /* bufferCount, unused for offload */,
+            mRenderer->getAudioSinkCallback(),
+            mRenderer.get(),
+            (audio_output_flags_t)(AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD
+                | AUDIO_OUTPUT_FLAG_DIRECT),
+            &offloadInfo);
+    if (err == OK) {
+        err = mAudioSink->start();
+    }
+    if (err != OK) {
+        DP_MSG_ERROR("audio sink refused offload (err=%d), decoding instead", err);
+        mAudioSink->close();
+        return err;
+    }
+
+    DP_MSG_HIGH("offloading audio, %d Hz, %d channels, %d bps",
+            sampleRate, numChannels, bitRate);
+    mRenderer->signalAudioSinkChanged();
+    return OK;
+}
+
 status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
     sp<AMessage> reply;
 
@@ -1457,7 +1980,15 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
     {
         Mutex::Autolock autoLock(mLock);
 
-        if (reply != NULL && (((track == kAudio) && mFlushingAudio != NONE)
+        // Switched decoders at the boundary already, only waiting for the
+        // other track's flush to finish, finishFlushIfPossible() posts the
+        // request again.
+        if (track == kAudio && mFlushingAudio == FLUSHED && mAudioSwitchedAtBoundary) {
+            mAudioParkedFillRequests.push_back(msg);
+            return OK;
+        }
+
+        if (reply != NULL && (((track == kAudio) && (mFlushingAudio != NONE || mAudioPathSwitchPending))
             || ((track == kVideo) && mFlushingVideo != NONE)
             || mSource == NULL)) {
             reply->setInt32("err", INFO_DISCONTINUITY);
@@ -1470,6 +2001,15 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
 
     sp<ABuffer> accessUnit;
 
+    if (track == kAudio && !mAudioReplay.empty()) {
+        // what the offloading sink had not played yet
+        accessUnit = *mAudioReplay.begin();
+        mAudioReplay.erase(mAudioReplay.begin());
+        reply->setBuffer("buffer", accessUnit);
+        reply->post();
+        return OK;
+    }
+
     bool dropAccessUnit;
     do {
 
@@ -1520,11 +2060,32 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
                             }
                         }
                     }
+
+                    // video already chose where the seek resumes
+                    if (track == kAudio && mSeekRenderFromUs >= 0) {
+                        mSkipRenderingAudioUntilMediaTimeUs = mSeekRenderFromUs;
+                    }
                 }
 
                 mTimeDiscontinuityPending =
                     mTimeDiscontinuityPending || timeChange;
 
+                if (formatChange) {
+                    if (track == kAudio) {
+                        mAudioReinitStartUs = ALooper::GetNowUs();
+                    } else if (track == kVideo) {
+                        mVideoReinitStartUs = ALooper::GetNowUs();
+                    }
+                }
+
+                if (formatChange && !timeChange && track == kAudio
+                        && canSwitchDecoder() && startDecoderSwitch()) {
+                    // the outgoing decoder drains what it has
+                    reply->setInt32("err", ERROR_END_OF_STREAM);
+                    reply->post();
+                    return OK;
+                }
+
                 if (formatChange || timeChange) {
                     flushDecoder(track, formatChange);
                 } else {
@@ -1559,14 +2120,28 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
 
         dropAccessUnit = false;
         if (track == kVideo) {
+            bool seeking =
+                mVideoSeekState != VIDEO_SEEK_NONE || mSeekMode == SEEK_CLOSEST_SYNC;
+
+            // read once, for both the seek and the drop decision
+            DashNALInfo nalInfo;
+            if ((mVideoIsAVC || mVideoIsHEVC) && (seeking || mDropController != NULL)) {
+                ClassifyNALUnits(accessUnit->data(), accessUnit->size(),
+                        mVideoIsAVC ? DashNALInfo::kCodecAVC : DashNALInfo::kCodecHEVC,
+                        &nalInfo);
+            }
+
+            if (seeking && skipVideoForSeek(accessUnit, nalInfo)) {
+                dropAccessUnit = true;
+                continue;
+            }
 
             if(mStats != NULL) {
                 mStats->incrementTotalFrames();
             }
 
-            if (mVideoLateByUs > 100000ll
-                    && mVideoIsAVC
-                    && !IsAVCReferenceFrame(accessUnit)) {
+            if (mDropController != NULL
+                    && mDropController->shouldDropBeforeDecode(nalInfo)) {
                 dropAccessUnit = true;
                 if(mStats != NULL) {
                     mStats->incrementDroppedFrames();
@@ -1578,6 +2153,11 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
     // DP_MSG_LOW("returned a valid buffer of %s data", mTrackName);
 
     if (track == kVideo || track == kAudio) {
+        int64_t timeUs;
+        if (accessUnit->meta()->findInt64("timeUs", &timeUs)
+                && timeUs > mMaxQueuedTimeUs) {
+            mMaxQueuedTimeUs = timeUs;
+        }
         reply->setBuffer("buffer", accessUnit);
         reply->post();
     } else if (track == kText) {
@@ -1589,6 +2169,168 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
     return OK;
 }
 
+/** @brief: replace the offloading audio decoder with a decoding one that
+ *          resumes where the sink stopped, video is left alone
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::switchAudioPath() {
+    if (mAudioDecoder == NULL || mRenderer == NULL || mAudioPathSwitchPending) {
+        return;
+    }
+
+    if (mFlushingAudio != NONE) {
+        // the sink loses what it holds to the flush anyway, switch once
+        // it is done unless it brings a new decoder
+        mAudioPathSwitchDeferred = true;
+        return;
+    }
+
+    DP_MSG_HIGH("switching the audio path from offload to decoding");
+
+    mAudioPathSwitchPending = true;
+    mAudioReplayPending = true;
+    mAudioReplay.clear();
+
+    mAudioDecoder->initiateShutdown();
+    mRenderer->endAudioOffload();
+}
+
+/** @brief: bring up the decoding audio decoder, once the offloading one
+ *          shut down and the renderer handed back what was not played
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::finishAudioPathSwitch() {
+    DP_MSG_HIGH("audio path switched, %zu access units to decode first",
+            mAudioReplay.size());
+
+    mAudioPathSwitchPending = false;
+    postScanSources();
+}
+
+/** @brief: give up on a switch a flush or reset took over
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::cancelAudioPathSwitch() {
+    mAudioPathSwitchPending = false;
+    mAudioReplayPending = false;
+    mAudioReplay.clear();
+}
+
+/** @brief: apply the seek mode to a video access unit after a seek, and
+ *          learn the sync sample interval for closest sync
+ *
+ *  @return: true if the access unit is not to be decoded
+ *
+ */
+bool DashPlayer::skipVideoForSeek(
+        const sp<ABuffer> &accessUnit, const DashNALInfo &info) {
+    int64_t timeUs;
+    if (!accessUnit->meta()->findInt64("timeUs", &timeUs)) {
+        return false;
+    }
+
+    bool classified = info.mValid;
+    bool isSync = classified && info.mIsRandomAccess;
+
+    if (isSync) {
+        if (mLastVideoSyncTimeUs >= 0 && timeUs > mLastVideoSyncTimeUs) {
+            mVideoSyncIntervalUs = timeUs - mLastVideoSyncTimeUs;
+        }
+        mLastVideoSyncTimeUs = timeUs;
+    }
+
+    switch (mVideoSeekState) {
+        case VIDEO_SEEK_AWAITING_FIRST:
+        {
+            int32_t mode = mPendingSeekMode;
+            if (!classified && mode != SEEK_EXACT) {
+                // nothing tells the sync samples apart
+                mode = SEEK_PREVIOUS_SYNC;
+            }
+
+            if (mode == SEEK_CLOSEST_SYNC) {
+                if (!isSync || mVideoSyncIntervalUs <= 0 || timeUs > mSeekTargetUs) {
+                    mode = SEEK_PREVIOUS_SYNC;
+                } else {
+                    int64_t previousUs = timeUs
+                        + (mSeekTargetUs - timeUs) / mVideoSyncIntervalUs * mVideoSyncIntervalUs;
+                    if (mSeekTargetUs - previousUs
+                            <= previousUs + mVideoSyncIntervalUs - mSeekTargetUs) {
+                        resumeSeekAt(previousUs, timeUs);
+                        return false;
+                    }
+                    mode = SEEK_NEXT_SYNC;
+                }
+            }
+
+            if (mode == SEEK_PREVIOUS_SYNC) {
+                resumeSeekAt(timeUs, timeUs);
+                return false;
+            } else if (mode == SEEK_EXACT) {
+                resumeSeekAt(mSeekTargetUs > timeUs ? mSeekTargetUs : timeUs, timeUs);
+                return false;
+            }
+
+            mVideoSeekState = VIDEO_SEEK_SEARCHING_SYNC;
+            // fall through
+        }
+
+        case VIDEO_SEEK_SEARCHING_SYNC:
+        {
+            if (isSync && timeUs >= mSeekTargetUs) {
+                resumeSeekAt(timeUs, timeUs);
+                return false;
+            }
+            return true;
+        }
+
+        case VIDEO_SEEK_SKIPPING:
+        {
+            if (timeUs >= mSeekRenderFromUs) {
+                mVideoSeekState = VIDEO_SEEK_NONE;
+                return false;
+            }
+            // HEVC _N pictures may still be referenced from higher sub-layers
+            return mVideoIsAVC && classified && info.mIsNonReference;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/** @brief: resume both tracks at renderFromUs after a seek, timeUs being
+ *          the video access unit about to be decoded
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::resumeSeekAt(int64_t renderFromUs, int64_t timeUs) {
+    DP_MSG_HIGH("seek to %lld us resumes at %lld us, decoding from %lld us",
+            mSeekTargetUs, renderFromUs, timeUs);
+
+    mSeekRenderFromUs = renderFromUs;
+    mSeekAwaitingOutput = true;
+    mVideoSeekState = (renderFromUs > timeUs) ? VIDEO_SEEK_SKIPPING : VIDEO_SEEK_NONE;
+
+    // the decoder drops what comes before, dashplayer never sees it
+    mSkipRenderingVideoUntilMediaTimeUs = -1;
+    if (renderFromUs > timeUs && mVideoDecoder != NULL) {
+        mVideoDecoder->setSkipOutputUntil(renderFromUs);
+    }
+    mSkipRenderingAudioUntilMediaTimeUs = renderFromUs;
+
+    if (mStats != NULL) {
+        mStats->markSeekStage(DashPlayerStats::kSeekStageInput);
+    }
+}
+
 void DashPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
     // DP_MSG_LOW("renderBuffer %s", audio ? "audio" : "video");
 
@@ -1612,16 +2354,43 @@ void DashPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
     sp<ABuffer> buffer;
     CHECK(msg->findBuffer("buffer", &buffer));
 
+    sp<BufferInfo> info = BufferInfo::Find(msg);
+    CHECK(info != NULL);
+
+    if (audio && mAudioPathSwitchPending) {
+        // offloaded access units that did not reach the renderer before
+        // it stopped, decoded after the ones it hands back
+        sp<ABuffer> copy = new ABuffer(buffer->size());
+        memcpy(copy->data(), buffer->data(), buffer->size());
+        copy->meta()->setInt64("timeUs", info->mTimeUs);
+        mAudioReplay.push_back(copy);
+
+        reply->post();
+        return;
+    }
+
     int64_t &skipUntilMediaTimeUs =
         audio
             ? mSkipRenderingAudioUntilMediaTimeUs
             : mSkipRenderingVideoUntilMediaTimeUs;
 
     if (skipUntilMediaTimeUs >= 0) {
-        int64_t mediaTimeUs;
-        CHECK(buffer->meta()->findInt64("timeUs", &mediaTimeUs));
+        int64_t mediaTimeUs = info->mTimeUs;
+
+        // Decoded audio is cut at the skip point rather than dropped
+        // whole, so playback resumes at exactly that sample.
+        bool trimmed = false;
+        if (audio && mediaTimeUs < skipUntilMediaTimeUs && mAudioPCMFrameSize > 0) {
+            trimmed = TrimPCMBuffer(
+                    buffer, &info->mTimeUs, skipUntilMediaTimeUs,
+                    mAudioPCMSampleRate, mAudioPCMFrameSize);
+            if (trimmed) {
+                DP_MSG_HIGH("trimmed audio buffer at time %lld to start at %lld",
+                     mediaTimeUs, info->mTimeUs);
+            }
+        }
 
-        if (mediaTimeUs < skipUntilMediaTimeUs) {
+        if (mediaTimeUs < skipUntilMediaTimeUs && !trimmed) {
             DP_MSG_HIGH("dropping %s buffer at time %lld as requested.",
                  audio ? "audio" : "video",
                  mediaTimeUs);
@@ -1631,200 +2400,255 @@ void DashPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
         }
 
         skipUntilMediaTimeUs = -1;
+        if (audio) {
+            mSeekRenderFromUs = -1;
+        }
+    }
+
+    if (!audio && mDropController != NULL) {
+        mDropController->onFrameDecoded(info->mDecodeLatencyUs);
     }
 
     if(mRenderer != NULL)
     {
-      if(!audio)
+      if(!audio && (info->mFlags & BufferInfo::FLAG_EXTRADATA) &&
+         info->mGraphicBuffer != NULL)
       {
-        int32_t extradata = 0;
-
-        if (buffer->meta()->findInt32("extradata", &extradata) && 1 == extradata)
-        {
-          DP_MSG_HIGH("kwhatdrainthisbuffer: Decoded sample contains SEI. Parse for CEA encoded cc extradata");
-
-          sp<RefBase> obj;
-
-          if (buffer->meta()->findObject("graphic-buffer", &obj))
-          {
-            sp<GraphicBuffer> graphicBuffer = static_cast<GraphicBuffer*>(obj.get());
-            if (graphicBuffer != NULL)
-            {
-              DP_MSG_LOW("kwhatdrainthisbuffer: Extradata present",
-                  "graphicBuffer = %p, width=%d height=%d color-format=%d",
-                  graphicBuffer.get(), mCurrentWidth, mCurrentHeight, mColorFormat);
+        DP_MSG_HIGH("kwhatdrainthisbuffer: Decoded sample contains SEI. Parse for CEA encoded cc extradata");
 
-              if (mColorFormat == 0x7FA30C04 /*OMX_QCOM_COLOR_FormatYUV420PackedSemiPlanar32m*/)
-              {
-                size_t filledLen = (VENUS_Y_STRIDE(COLOR_FMT_NV12, mCurrentWidth)
-                                    * VENUS_Y_SCANLINES(COLOR_FMT_NV12, mCurrentHeight))
-                                          +  (VENUS_UV_STRIDE(COLOR_FMT_NV12, mCurrentWidth)
-                                              * VENUS_UV_SCANLINES(COLOR_FMT_NV12, mCurrentHeight));
-                size_t allocLen = VENUS_BUFFER_SIZE(COLOR_FMT_NV12, mCurrentWidth, mCurrentHeight);
-                size_t offset = buffer->offset();
-
-                DP_MSG_LOW("kwhatdrainthisbuffer: decoded buffer ranges "
-                  "filledLen = %lu, allocLen = %lu, startOffset = %lu",
-                  filledLen, allocLen, offset);
-
-                // 'lock' returns mapped virtual address that can be read from or written into
-                //  Use GRALLOC_USAGE_SW_READ_MASK / WRITE_MASK to indicate access type
-                // 'unlock' will unmap the mapped address
-
-                void *yuvData = NULL;
-                graphicBuffer->lock(GRALLOC_USAGE_SW_READ_MASK, &yuvData);
+        if (mCaptionExtractor == NULL) {
+            mCaptionExtractor = new CaptionExtractor(
+                    new AMessage(kWhatCaptionNotify, id()));
+            mCaptionExtractor->init();
+        }
 
-                if (yuvData)
-                {
-                  OMX_OTHER_EXTRADATATYPE *pExtra;
-                  pExtra = (OMX_OTHER_EXTRADATATYPE *)((unsigned long)((OMX_U8*)yuvData + offset + filledLen + 3)&(~3));
+        // The frame goes to the renderer right away, the decoder gets it
+        // back once the extractor is done reading it.
+        reply = mCaptionExtractor->extract(
+                buffer, info, mCurrentWidth, mCurrentHeight, mColorFormat,
+                mCaptionGeneration, reply);
+      }
 
-                  while (pExtra &&
-                    ((OMX_U8*)pExtra + pExtra->nSize) <= ((OMX_U8*)yuvData + allocLen) &&
-                    pExtra->eType != OMX_ExtraDataNone )
-                  {
-                    DP_MSG_LOW(
-                      "============== Extra Data ==============\n"
-                      "           Size: %lu\n"
-                      "        Version: %lu\n"
-                      "      PortIndex: %lu\n"
-                      "           Type: %x\n"
-                      "       DataSize: %lu",
-                      pExtra->nSize, pExtra->nVersion.nVersion,
-                      pExtra->nPortIndex, pExtra->eType, pExtra->nDataSize);
-
-                    if(pExtra->eType == (OMX_EXTRADATATYPE) OMX_ExtraDataMP2UserData)
-                    {
-                      OMX_QCOM_EXTRADATA_USERDATA *userdata = (OMX_QCOM_EXTRADATA_USERDATA *)pExtra->data;
-                      OMX_U8 *data_ptr = (OMX_U8 *)userdata->data;
-                      OMX_U32 userdata_size = pExtra->nDataSize - (OMX_U32)sizeof(userdata->type);
-
-                      DP_MSG_LOW(
-                        "--------------  OMX_ExtraDataMP2UserData Userdata  -------------\n"
-                        "    Stream userdata type: %lu\n"
-                        "           userdata size: %lu\n"
-                        "         STREAM_USERDATA:",
-                        userdata->type, userdata_size);
-
-                      for (uint32_t i = 0; i < userdata_size; i+=4) {
-                        DP_MSG_LOW("        %x %x %x %x",
-                          data_ptr[i], data_ptr[i+1],
-                          data_ptr[i+2], data_ptr[i+3]);
-                      }
+      mRenderer->queueBuffer(audio, buffer, info, reply);
+    }
+}
 
-                      DP_MSG_LOW(
-                        "-------------- End of OMX_ExtraDataMP2UserData Userdata -----------");
+void DashPlayer::notifyListener(int msg, int ext1, int ext2, const Parcel *obj) {
+    if (mDriver == NULL) {
+        return;
+    }
 
-                      /*
-                      SEI Syntax
+    sp<DashPlayerDriver> driver = mDriver.promote();
 
-                      user_data_registered_itu_t_t35 ( ) {
-                      itu_t_t35_country_code (8 bits)
-                      itu_t_t35_provider_code (16 bits)
-                      user_identifier (32 bits)
-                      user_structure( )
-                      }
+    if (driver == NULL) {
+        return;
+    }
 
-                      cc_data parsing logic
-                      1. itu_t_t35_country_code - A fixed 8-bit field, the value of which shall be 0xB5.3
-                      itu_t_35_provider_code - A fixed 16-bit field, the value of which shall be 0x0031.
-                      2. user_identifier should match 0x47413934 ('GA94') ATSC_user_data( )
+        driver->notifyListener(msg, ext1, ext2, obj);
+}
 
-                      ATSC_user_data Syntax
-                      ATSC_user_data() {
-                      user_data_type_code (8 bits)
-                      user_data_type_structure()
-                      }
+sp<DashPlayer::Decoder> DashPlayer::takePooledDecoder(const AString &key) {
+    for (size_t i = 0; i < mDecoderPool.size(); ++i) {
+        if (mDecoderPool[i].mKey == key) {
+            sp<Decoder> decoder = mDecoderPool[i].mDecoder;
+            mDecoderPool.removeAt(i);
+            return decoder;
+        }
+    }
+    return NULL;
+}
 
-                      3. user_data_type_code should match 0x03 MPEG_cc_data()
+void DashPlayer::parkDecoder(const sp<Decoder> &decoder) {
+    const AString &key = decoder->getPoolKey();
 
-                      */
+    // the newest of a key is kept, then the oldest of all is evicted
+    for (size_t i = 0; i < mDecoderPool.size(); ++i) {
+        if (mDecoderPool[i].mKey == key) {
+            retireDecoder(mDecoderPool[i].mDecoder, false /* park */);
+            mDecoderPool.removeAt(i);
+            break;
+        }
+    }
+    while (!mDecoderPool.isEmpty() && mDecoderPool.size() >= mMaxPooledDecoders) {
+        retireDecoder(mDecoderPool[0].mDecoder, false /* park */);
+        mDecoderPool.removeAt(0);
+    }
 
-                      if(0xB5 == data_ptr[0] && 0x00 == data_ptr[1] && 0x31 == data_ptr[2]
-                      && 0x47 == data_ptr[3] && 0x41 == data_ptr[4] && 0x39 == data_ptr[5] && 0x34 == data_ptr[6]
-                      && 0x03 == data_ptr[7])
-                      {
-                        DP_MSG_HIGH("SEI payload user_data_type_code is CEA encoded MPEG_cc_data()");
+    PooledDecoder entry;
+    entry.mKey = key;
+    entry.mDecoder = decoder;
+    mDecoderPool.push(entry);
+    DP_MSG_HIGH("parked %s decoder, %zu pooled", key.c_str(), mDecoderPool.size());
+}
 
-                        OMX_U32 cc_data_size = 0;
-                        for(int i = 8; data_ptr[i] != 0xFF /*each cc_data ends with marker bits*/; i++)
-                        {
-                          cc_data_size++;
-                        }
+void DashPlayer::retireDecoder(const sp<Decoder> &decoder, bool park) {
+    decoder->initiateRetirement(park);
+    mRetiredDecoders.push(decoder);
+}
 
-                        if(cc_data_size > 0)
-                        {
-                          DP_MSG_LOW(
-                            "--------------  MPEG_cc_data()  -------------\n"
-                            "    cc_data ptr: %p cc_data_size: %lu\n",
-                            &data_ptr[8], cc_data_size);
-
-                          for (uint32_t i = 8; i < 8 + cc_data_size; i+=4) {
-                            DP_MSG_LOW("        %x %x %x %x",
-                              data_ptr[i], data_ptr[i+1],
-                              data_ptr[i+2], data_ptr[i+3]);
-                          }
+void DashPlayer::purgeDecoderPool() {
+    while (!mDecoderPool.isEmpty()) {
+        retireDecoder(mDecoderPool[0].mDecoder, false /* park */);
+        mDecoderPool.removeAt(0);
+    }
+}
 
-                          DP_MSG_LOW(
-                            "--------------  End of MPEG_cc_data()  -------------\n");
+/** @brief: release the parked decoders of a track type unless one of them
+ *          can be reused for key, so that a new decoder does not compete
+ *          with stopped components for the hardware instances
+ *
+ *  @return: true while a component of that track type is still being
+ *           released, the new decoder should be created after it
+ *
+ */
+bool DashPlayer::releasePooledDecoders(int track, const AString &key) {
+    const char *prefix = (track == kAudio) ? "audio/" : "video/";
 
-                          sp<ABuffer> accessUnit = new ABuffer((OMX_U8*)&data_ptr[8], cc_data_size);
+    for (size_t i = 0; i < mDecoderPool.size(); ++i) {
+        if (mDecoderPool[i].mKey == key) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < mDecoderPool.size();) {
+        if (mDecoderPool[i].mKey.startsWith(prefix)) {
+            DP_MSG_HIGH("releasing parked %s decoder", mDecoderPool[i].mKey.c_str());
+            retireDecoder(mDecoderPool[i].mDecoder, false /* park */);
+            mDecoderPool.removeAt(i);
+        } else {
+            ++i;
+        }
+    }
+    for (size_t i = 0; i < mRetiredDecoders.size(); ++i) {
+        if (mRetiredDecoders[i]->getPoolKey().startsWith(prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-                          int64_t mediaTimeUs;
+/** @brief: whether an audio format change without a time change can be
+ *          handled with a decoder switch
+ *
+ *  @return: true if the next decoder can preroll next to the current one
+ *
+ */
+bool DashPlayer::canSwitchDecoder() {
+    if (!mPrerollDecoders || mRenderer == NULL || mResetInProgress || mResetPostponed
+            || mFlushingAudio != NONE || mFlushingVideo != NONE) {
+        return false;
+    }
 
-                          sp<ABuffer> buffer;
-                          CHECK(msg->findBuffer("buffer", &buffer));
-                          CHECK(buffer->meta()->findInt64("timeUs", &mediaTimeUs));
-                          accessUnit->meta()->setInt64("timeUs",mediaTimeUs);
+    // decoded PCM of a known layout, offloaded audio has no decoder
+    return mAudioOutgoingDecoder == NULL && mAudioPCMFrameSize > 0;
+}
 
-                          //To signal discontinuity in samples during seek and resume-out-of-tsb(internal seek) operations
-                          if(mTimedTextCEASamplesDisc)
-                          {
-                            accessUnit->meta()->setInt32("disc", 1);
-                            mTimedTextCEASamplesDisc = false;
-                          }
+/** @brief: instantiate the next audio decoder next to the current one
+ *
+ *  @return: false, changing nothing, if the next format isn't known yet
+ *
+ */
+bool DashPlayer::startDecoderSwitch() {
+    sp<Decoder> outgoing = mAudioDecoder;
+    mAudioDecoder.clear();
+
+    if (instantiateDecoder(kAudio, &mAudioDecoder, true /* preroll */) != OK
+            || mAudioDecoder == NULL) {
+        mAudioDecoder = outgoing;
+        return false;
+    }
+
+    DP_MSG_HIGH("audio format change, decoder switch started");
+    mAudioOutgoingDecoder = outgoing;
+    mAudioSwitchedAtBoundary = true;
+    // what is left of the gap is measured from the outgoing EOS on
+    mAudioReinitStartUs = -1;
+    return true;
+}
 
-                          //Indicate timedtext CEA present in stream. Used to signal EOS in Codec::kWhatEOS
-                          if(!mTimedTextCEAPresent)
-                          {
-                            mTimedTextCEAPresent = true;
-                          }
+/** @brief: handle a notification from either audio decoder during a switch
+ *
+ *  @return: true if it was consumed
+ *
+ */
+bool DashPlayer::routeSwitchingNotify(int32_t what, const sp<AMessage> &msg) {
+    if (mAudioOutgoingDecoder == NULL) {
+        return false;
+    }
+
+    int32_t decoderId = 0;
+    msg->findInt32("decoder-id", &decoderId);
+    if (decoderId == mAudioOutgoingDecoder->id()) {
+        if (what == Decoder::kWhatFillThisBuffer) {
+            // its input ended at the boundary, it keeps the buffer
+            sp<AMessage> reply;
+            CHECK(msg->findMessage("reply", &reply));
+            reply->setInt32("err", OK);
+            reply->post();
+            return true;
+        } else if (what == Decoder::kWhatEOS) {
+            completeDecoderSwitch();
+            return true;
+        }
+        // its output is rendered and its errors handled as before
+        return false;
+    }
 
-                          sendTextPacket(accessUnit, OK, TIMED_TEXT_CEA);
+    if (what == Decoder::kWhatDrainThisBuffer
+            || what == Decoder::kWhatOutputFormatChanged
+            || what == Decoder::kWhatEOS) {
+        mAudioHeldNotifies.push_back(msg);
+        return true;
+    }
+    return false;
+}
 
-                          accessUnit = NULL;
-                          break;
-                        }
-                      }
-                    }
+/** @brief: the outgoing audio decoder drained, hand over to the next one
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::completeDecoderSwitch() {
+    DP_MSG_HIGH("audio outgoing decoder drained, %zu notifications held",
+            mAudioHeldNotifies.size());
 
-                    pExtra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) pExtra) + pExtra->nSize);
-                  }
+    retireDecoder(mAudioOutgoingDecoder, mMaxPooledDecoders > 0 /* park */);
+    mAudioOutgoingDecoder.clear();
 
-                  graphicBuffer->unlock();
-                }
-              }
-            }
-          }
-        }
-      }
+    mAudioReinitStartUs = ALooper::GetNowUs();
 
-      mRenderer->queueBuffer(audio, buffer, reply);
+    mReplayingHeldNotifies = true;
+    while (!mAudioHeldNotifies.empty()) {
+        sp<AMessage> msg = *mAudioHeldNotifies.begin();
+        mAudioHeldNotifies.erase(mAudioHeldNotifies.begin());
+        onMessageReceived(msg);
     }
+    mReplayingHeldNotifies = false;
 }
 
-void DashPlayer::notifyListener(int msg, int ext1, int ext2, const Parcel *obj) {
-    if (mDriver == NULL) {
+/** @brief: drop the outgoing audio decoder when audio is flushed
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::abortDecoderSwitch() {
+    // its parked requests go stale with the flush
+    mAudioParkedFillRequests.clear();
+
+    if (mAudioOutgoingDecoder == NULL) {
         return;
     }
 
-    sp<DashPlayerDriver> driver = mDriver.promote();
+    DP_MSG_HIGH("audio flushed during a decoder switch");
+    retireDecoder(mAudioOutgoingDecoder, mMaxPooledDecoders > 0 /* park */);
+    mAudioOutgoingDecoder.clear();
 
-    if (driver == NULL) {
-        return;
+    // Called with the track flushing, held output goes straight back to
+    // the decoder and a held format change still reaches the sink.
+    while (!mAudioHeldNotifies.empty()) {
+        sp<AMessage> msg = *mAudioHeldNotifies.begin();
+        mAudioHeldNotifies.erase(mAudioHeldNotifies.begin());
+        onMessageReceived(msg);
     }
-
-        driver->notifyListener(msg, ext1, ext2, obj);
 }
 
 void DashPlayer::flushDecoder(bool audio, bool needShutdown) {
@@ -1837,20 +2661,37 @@ void DashPlayer::flushDecoder(bool audio, bool needShutdown) {
     ++mScanSourcesGeneration;
     mScanSourcesPending = false;
 
-    (audio ? mAudioDecoder : mVideoDecoder)->signalFlush();
+    // An offloading decoder being replaced is shutting down already, the
+    // flush drops what the sink had not played.
+    bool shuttingDown = audio && mAudioPathSwitchPending;
+    if (shuttingDown) {
+        cancelAudioPathSwitch();
+    } else {
+        (audio ? mAudioDecoder : mVideoDecoder)->signalFlush();
+    }
+
+    if (!audio) {
+        // Drop captions still being extracted from pre-flush frames.
+        ++mCaptionGeneration;
+
+        if (mDropController != NULL) {
+            mDropController->reset();
+        }
+    }
 
     if(mRenderer != NULL) {
         mRenderer->flush(audio);
     }
 
-    FlushStatus newStatus =
-        needShutdown ? FLUSHING_DECODER_SHUTDOWN : FLUSHING_DECODER;
+    FlushStatus newStatus = shuttingDown ? SHUTTING_DOWN_DECODER
+        : needShutdown ? FLUSHING_DECODER_SHUTDOWN : FLUSHING_DECODER;
 
     if (audio) {
         CHECK(mFlushingAudio == NONE
                 || mFlushingAudio == AWAITING_DISCONTINUITY);
 
         mFlushingAudio = newStatus;
+        mAudioSwitchedAtBoundary = false;
 
         if (mFlushingVideo == NONE) {
             mFlushingVideo = (mVideoDecoder != NULL)
@@ -1864,11 +2705,87 @@ void DashPlayer::flushDecoder(bool audio, bool needShutdown) {
         mFlushingVideo = newStatus;
 
         if (mFlushingAudio == NONE) {
-            mFlushingAudio = (mAudioDecoder != NULL)
+            mFlushingAudio = (mAudioDecoder != NULL && !mAudioSwitchedAtBoundary)
                 ? AWAITING_DISCONTINUITY
                 : FLUSHED;
         }
     }
+
+    if (audio) {
+        abortDecoderSwitch();
+    }
+}
+
+// Live latency is sampled at most this often.
+static const int64_t kLiveLatencyIntervalUs = 500000ll;
+
+void DashPlayer::updateLiveLatency(int64_t positionUs) {
+    if (!mLiveController->isEnabled()) {
+        if (mLiveRate != 1.0f) {
+            mLiveRate = 1.0f;
+            applyPlaybackRate();
+        }
+        return;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mSource == NULL || (mLastLiveUpdateUs >= 0
+            && nowUs < mLastLiveUpdateUs + kLiveLatencyIntervalUs)) {
+        return;
+    }
+    mLastLiveUpdateUs = nowUs;
+
+    // A stream with a duration is not live.
+    int64_t durationUs;
+    if (mSource->getDuration(&durationUs) == OK && durationUs > 0) {
+        return;
+    }
+
+    uint64_t nMin = 0, nMax = 0, nMaxDepth = 0;
+    status_t err = mSource->getRepositionRange(&nMin, &nMax, &nMaxDepth);
+    if (err != OK || nMax == 0) {
+        return;
+    }
+
+    int64_t latencyUs = (int64_t)nMax * 1000ll - positionUs;
+    if (latencyUs < 0) {
+        return;
+    }
+
+    int64_t bufferedUs =
+        mMaxQueuedTimeUs > positionUs ? mMaxQueuedTimeUs - positionUs : 0;
+
+    float rate = mLiveController->onLatencySample(nowUs, latencyUs, bufferedUs);
+    DP_MSG_LOW("live latency %lld us, buffered %lld us, rate %.2f",
+         latencyUs, bufferedUs, rate);
+
+    if (rate != mLiveRate) {
+        mLiveRate = rate;
+        applyPlaybackRate();
+    }
+}
+
+void DashPlayer::resetLiveLatency() {
+    mLastLiveUpdateUs = -1ll;
+    mMaxQueuedTimeUs = -1ll;
+    mLiveController->reset();
+    if (mLiveRate != 1.0f) {
+        mLiveRate = 1.0f;
+        applyPlaybackRate();
+    }
+}
+
+void DashPlayer::applyPlaybackRate() {
+    float rate = mPlaybackRate * mLiveRate;
+    if (rate < 0.5f) {
+        rate = 0.5f;
+    } else if (rate > 2.0f) {
+        rate = 2.0f;
+    }
+
+    if (mRenderer != NULL) {
+        mRenderer->setPlaybackRate(rate);
+    }
 }
 
 sp<DashPlayer::Source>
@@ -1994,6 +2911,16 @@ status_t DashPlayer::getParameter(int key, Parcel *reply)
           reply->writeInt32(videoSize);
           videoUrl.append('\0');
           reply->write((const uint8_t *)videoUrl.c_str(), videoSize+1);
+
+          // live latency, appended so existing readers are unaffected
+          DashLiveLatencyController::Report live;
+          mLiveController->getReport(&live);
+          reply->writeInt32(live.mTargetUs > 0 ? 1 : 0);
+          reply->writeInt64(live.mTargetUs / 1000);
+          reply->writeInt64(live.mLatencyUs < 0 ? -1 : live.mLatencyUs / 1000);
+          reply->writeInt64(live.mMeanUs / 1000);
+          reply->writeInt64(live.mVarianceMs2);
+          reply->writeInt32((int32_t)(live.mRate * 1000));
         }else
         {
           DP_MSG_ERROR("DashPlayerStats::getParameter : data_8 is null");
@@ -2045,6 +2972,19 @@ status_t DashPlayer::setParameter(int key, const Parcel &request)
           err = mSource->setParameter(key, data, len);
         }
         free(data);
+    }else if(key == KEY_DASH_LIVE_TARGET_LATENCY)
+    {
+      int32_t targetMs = request.readInt32();
+      if (targetMs < 0)
+      {
+        return BAD_VALUE;
+      }
+      // the player thread returns to mPlaybackRate on the next position
+      mLiveController->setTargetLatencyUs(targetMs * 1000ll);
+      err = OK;
+    }else if(key == KEY_DASH_SEEK_MODE)
+    {
+      err = setSeekMode(request.readInt32());
     }else if(key == KEY_DASH_QOE_EVENT)
     {
       int value  = request.readInt32();
@@ -2284,6 +3224,8 @@ void DashPlayer::processDeferredActions() {
 void DashPlayer::performSetSurface(const sp<NativeWindowWrapper> &wrapper) {
     DP_MSG_HIGH("performSetSurface");
 
+    // pooled video decoders render to the old window
+    purgeDecoderPool();
     mNativeWindow = wrapper;
 
     // XXX - ignore error from setVideoScalingMode for now
@@ -19,12 +19,15 @@
 #define DASH_PLAYER_H_
 
 #include "DashPlayerStats.h"
+#include "DashFrameDropController.h"
+#include "DashLiveLatencyController.h"
 #include <media/MediaPlayerInterface.h>
 #include <media/stagefright/NativeWindowWrapper.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <ui/GraphicBuffer.h>
 
 #define KEY_QCTIMEDTEXT_LISTENER 6000
 
@@ -32,6 +35,9 @@
 #define KEY_DASH_SEEK_EVENT 7001
 #define KEY_DASH_PAUSE_EVENT 7002
 #define KEY_DASH_RESUME_EVENT 7003
+#define KEY_DASH_PLAYBACK_RATE 7004  // rate in 1/1000, 500 to 2000
+#define KEY_DASH_LIVE_TARGET_LATENCY 7005  // ms behind the live edge, 0 is off
+#define KEY_DASH_SEEK_MODE 7006  // DashPlayer::SeekMode of the seeks that follow
 
 // used for Get Adaptionset property (NonJB)and for both Get and set for JB
 #define KEY_DASH_ADAPTION_PROPERTIES 8002
@@ -79,12 +85,27 @@ struct DashPlayer : public AHandler {
     void pause();
     void resume();
 
+    // BAD_VALUE outside 0.5 to 2.0. Audio keeps its pitch.
+    status_t setPlaybackRate(float rate);
+
     // Will notify the driver through "notifyResetComplete" once finished.
     void resetAsync();
 
+    // Where playback resumes after a seek, relative to the video sync
+    // samples around the target. Values as MediaPlayer's SEEK_* modes.
+    enum SeekMode {
+        SEEK_PREVIOUS_SYNC  = 0,
+        SEEK_NEXT_SYNC      = 1,
+        SEEK_CLOSEST_SYNC   = 2,
+        SEEK_EXACT          = 3,
+    };
+
     // Will notify the driver through "notifySeekComplete" once finished.
     void seekToAsync(int64_t seekTimeUs);
 
+    // BAD_VALUE for anything but a SeekMode, applies to later seeks.
+    status_t setSeekMode(int32_t mode);
+
     status_t prepareAsync();
     status_t getParameter(int key, Parcel *reply);
     status_t setParameter(int key, const Parcel &request);
@@ -103,12 +124,45 @@ protected:
 private:
     struct Decoder;
     struct Renderer;
+    struct CaptionExtractor;
     struct Source;
     struct Action;
     struct SimpleAction;
     struct SetSurfaceAction;
     struct ShutdownDecoderAction;
 
+    // Typed per-frame information. The decoder posts one instance with
+    // every decoded buffer, in the kWhatDrainThisBuffer notification and
+    // then the renderer's queue message, so the player and renderer read a
+    // struct instead of repeating string-keyed lookups on the buffer's meta().
+    struct BufferInfo : public RefBase {
+        enum {
+            FLAG_EXTRADATA = 1,
+        };
+
+        BufferInfo() : mTimeUs(-1), mFlags(0), mDecodeLatencyUs(-1) {}
+
+        // Returns the info posted along with the buffer in msg, or NULL.
+        static sp<BufferInfo> Find(const sp<AMessage> &msg) {
+            sp<RefBase> obj;
+            if (!msg->findObject("info", &obj)) {
+                return NULL;
+            }
+            return static_cast<BufferInfo *>(obj.get());
+        }
+
+        int64_t mTimeUs;
+        uint32_t mFlags;
+        int64_t mDecodeLatencyUs;  // input queued to output, -1 if unknown
+        sp<GraphicBuffer> mGraphicBuffer;
+
+    protected:
+        virtual ~BufferInfo() {}
+
+    private:
+        DISALLOW_EVIL_CONSTRUCTORS(BufferInfo);
+    };
+
     enum {
           // These keys must be in sync with the keys in QCTimedText.java
           KEY_DISPLAY_FLAGS                 = 1, // int
@@ -162,6 +216,9 @@ private:
         kWhatPrepareAsync               = 'pras',
         kWhatIsPrepareDone              = 'prdn',
         kWhatSourceNotify               = 'snfy',
+        kWhatCaptionNotify              = 'capN',
+        kWhatSetPlaybackRate            = 'sRat',
+        kWhatSetSeekMode                = 'sSkM',
     };
 
     enum {
@@ -177,10 +234,110 @@ private:
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<Decoder> mVideoDecoder;
     bool mVideoIsAVC;
+    bool mVideoIsHEVC;
     sp<Decoder> mAudioDecoder;
     sp<Decoder> mTextDecoder;
     sp<Renderer> mRenderer;
 
+    // With persist.dash.player.threads set, the renderer (audio sink writes
+    // and video render scheduling) runs here instead of on the player
+    // looper, so source, text and CEA handling cannot delay audio writes.
+    bool mUseRendererLooper;
+    sp<ALooper> mRendererLooper;
+
+    // With persist.dash.audio.offload set, AAC is handed to an offloading
+    // AudioSink undecoded when there is no video surface. Cleared for the
+    // rest of the session if the sink tears the offloaded track down.
+    bool mOffloadAudio;
+
+    // When offload ends early only the audio decoder is replaced, see
+    // switchAudioPath(). The new one is brought up once the old one shut
+    // down and the renderer handed back the access units from the one the
+    // sink stopped in (mAudioReplayPending), and is fed those first, the
+    // decoded PCM trimmed to the sink's position. Deferred while a flush
+    // is in progress.
+    bool mAudioPathSwitchPending;
+    bool mAudioReplayPending;
+    bool mAudioPathSwitchDeferred;
+    List<sp<ABuffer> > mAudioReplay;
+
+    // Applied to every renderer, offload is only chosen at 1x.
+    float mPlaybackRate;
+
+    // Live mode (persist.dash.live.target.ms or KEY_DASH_LIVE_TARGET_LATENCY):
+    // on position updates the latency behind the edge of the reposition
+    // range drives the live rate, which scales mPlaybackRate.
+    sp<DashLiveLatencyController> mLiveController;
+    float mLiveRate;
+    int64_t mLastLiveUpdateUs;
+    int64_t mMaxQueuedTimeUs;  // latest access unit handed to a decoder
+
+    // Decoders shut down for a format change are parked here, component
+    // still allocated, oldest first, at most persist.dash.decoder.pool
+    // of them (0 turns parking off). A later decoder of the same pool key
+    // is started from here in place. Evicted ones wait in mRetiredDecoders
+    // until their codec is released. A decoder of a new key is only created
+    // once the parked ones of its track type are released, the SoC may not
+    // have a spare instance.
+    struct PooledDecoder {
+        AString mKey;
+        sp<Decoder> mDecoder;
+    };
+    Vector<PooledDecoder> mDecoderPool;
+    Vector<sp<Decoder> > mRetiredDecoders;
+    size_t mMaxPooledDecoders;
+    bool mDecoderReleasePending;
+
+    // From a format change discontinuity to the next decoder's first
+    // output, -1 if none pending. Warm if the decoder came from the pool.
+    int64_t mAudioReinitStartUs;
+    int64_t mVideoReinitStartUs;
+    bool mAudioReinitWarm;
+    bool mVideoReinitWarm;
+
+    // At a format change without a time change (persist.dash.decoder.preroll)
+    // the outgoing decoder gets EOS and drains into the renderer while the
+    // next one is already configured and decoding the new period. Output of
+    // the next decoder is held until the outgoing one reaches EOS, then
+    // handled in order. Decoder notifications carry "decoder-id" to tell
+    // the two apart. Audio only: a video decoder needs the surface, which
+    // takes one codec at a time.
+    bool mPrerollDecoders;
+    sp<Decoder> mAudioOutgoingDecoder;
+    List<sp<AMessage> > mAudioHeldNotifies;
+    bool mReplayingHeldNotifies;
+
+    // Audio already passed its discontinuity with a switch, a flush of
+    // video for the same boundary doesn't wait for it. Fill requests of
+    // the next decoder are parked meanwhile and posted again once the
+    // flush finished.
+    bool mAudioSwitchedAtBoundary;
+    List<sp<AMessage> > mAudioParkedFillRequests;
+
+    // Seek mode (persist.dash.seek.mode or KEY_DASH_SEEK_MODE). The first
+    // video access unit after a seek, the sync sample the source landed
+    // on, decides mSeekRenderFromUs, where both tracks resume: that sync
+    // sample, the target, or the next sync sample, in which case the access
+    // units before it are not decoded at all. On the way to a later point
+    // AVC pictures nothing references are not decoded, and the video
+    // decoder releases the other frames before it without handing them
+    // out. Closest sync needs the sync sample interval, learned from the
+    // stream, and falls back to the previous sync sample until it is known.
+    enum VideoSeekState {
+        VIDEO_SEEK_NONE,
+        VIDEO_SEEK_AWAITING_FIRST,  // first access unit after the seek
+        VIDEO_SEEK_SEARCHING_SYNC,  // dropping up to a sync at the target
+        VIDEO_SEEK_SKIPPING,        // decoding up to mSeekRenderFromUs
+    };
+    int32_t mSeekMode;
+    int32_t mPendingSeekMode;  // of the seek in progress
+    VideoSeekState mVideoSeekState;
+    int64_t mSeekTargetUs;
+    int64_t mSeekRenderFromUs;   // -1 until decided, and once audio got there
+    bool mSeekAwaitingOutput;    // first video output not seen yet
+    int64_t mLastVideoSyncTimeUs;
+    int64_t mVideoSyncIntervalUs;  // 0 until two sync samples were seen
+
     List<sp<Action> > mDeferredActions;
 
     bool mAudioEOS;
@@ -236,6 +393,11 @@ private:
     int64_t mSkipRenderingAudioUntilMediaTimeUs;
     int64_t mSkipRenderingVideoUntilMediaTimeUs;
 
+    // Layout of the audio decoder's PCM output, 0 until its format is
+    // known and while audio is offloaded.
+    uint32_t mAudioPCMSampleRate;
+    size_t mAudioPCMFrameSize;
+
     int64_t mVideoLateByUs;
 
     bool mPauseIndication;
@@ -249,7 +411,10 @@ private:
 
     int32_t mSRid;
 
-    status_t instantiateDecoder(int track, sp<Decoder> *decoder);
+    // With preroll the renderer and audio sink are left alone, they still
+    // play the outgoing decoder's output.
+    status_t instantiateDecoder(int track, sp<Decoder> *decoder, bool preroll = false);
+    status_t openAudioSinkForOffload(const sp<MetaData> &meta);
 
     status_t feedDecoderInputData(int track, const sp<AMessage> &msg);
     void renderBuffer(bool audio, const sp<AMessage> &msg);
@@ -260,8 +425,38 @@ private:
 
     void flushDecoder(bool audio, bool needShutdown);
 
+    sp<Decoder> takePooledDecoder(const AString &key);
+    void parkDecoder(const sp<Decoder> &decoder);
+    void retireDecoder(const sp<Decoder> &decoder, bool park);
+    void purgeDecoderPool();
+    bool releasePooledDecoders(int track, const AString &key);
+
+    bool canSwitchDecoder();
+    bool startDecoderSwitch();
+    bool routeSwitchingNotify(int32_t what, const sp<AMessage> &msg);
+    void completeDecoderSwitch();
+    void abortDecoderSwitch();
+
+    void switchAudioPath();
+    void finishAudioPathSwitch();
+    void cancelAudioPathSwitch();
+
+    bool skipVideoForSeek(const sp<ABuffer> &accessUnit, const DashNALInfo &info);
+    void resumeSeekAt(int64_t renderFromUs, int64_t timeUs);
+
+    void updateLiveLatency(int64_t positionUs);
+    void resetLiveLatency();
+    void applyPlaybackRate();
+
     static bool IsFlushingState(FlushStatus state, bool *needShutdown = NULL);
 
+    // Skips the PCM frames of buffer before untilUs and advances *timeUs
+    // to the first frame kept. Returns false, leaving the buffer alone, if
+    // all of it precedes untilUs.
+    static bool TrimPCMBuffer(
+            const sp<ABuffer> &buffer, int64_t *timeUs, int64_t untilUs,
+            uint32_t sampleRate, size_t frameSize);
+
     void finishReset();
     void postScanSources();
 
@@ -273,6 +468,9 @@ private:
     // for qualcomm statistics profiling
     sp<DashPlayerStats> mStats;
 
+    // Shared with the renderer, which reports per-frame lateness.
+    sp<DashFrameDropController> mDropController;
+
     void sendTextPacket(sp<ABuffer> accessUnit, status_t err, DashPlayer::TimedTextType eTimedTextType = TIMED_TEXT_SMPTE);
     void getTrackName(int track, char* name);
     void prepareSource();
@@ -290,6 +488,11 @@ private:
     //Set and reset in cases of seek/resume-out-of-tsb to signal discontinuity in CEA timedtextsamples
     bool mTimedTextCEASamplesDisc;
 
+    // Extracts CEA cc_data from decoded frames off the player looper,
+    // created on the first frame that carries extradata.
+    sp<CaptionExtractor> mCaptionExtractor;
+    int32_t mCaptionGeneration;
+
     //Tells if app registered for a QCTimedText Listener. If not registered do not send text samples above.
     bool mQCTimedTextListenerPresent;
 
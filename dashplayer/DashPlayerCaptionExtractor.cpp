@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashPlayerCaptionExtractor"
+
+#include "DashPlayerCaptionExtractor.h"
+#include "DashCaptionParser.h"
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include "OMX_QCOMExtns.h"
+#include <gralloc_priv.h>
+#include <cutils/properties.h>
+#include <utils/Log.h>
+#include <media/msm_media_info.h>
+
+#define DPC_MSG_ERROR(...) ALOGE(__VA_ARGS__)
+#define DPC_MSG_HIGH(...) if(mLogLevel >= 1){ALOGE(__VA_ARGS__);}
+#define DPC_MSG_MEDIUM(...) if(mLogLevel >= 2){ALOGE(__VA_ARGS__);}
+#define DPC_MSG_LOW(...) if(mLogLevel >= 3){ALOGE(__VA_ARGS__);}
+
+namespace android {
+
+DashPlayer::CaptionExtractor::CaptionExtractor(const sp<AMessage> &notify)
+    : mNotify(notify),
+      mLogLevel(0) {
+    mLooper = new ALooper;
+    mLooper->setName("DashPlayerCaptions");
+    mLooper->start(false, false, ANDROID_PRIORITY_DEFAULT);
+
+    char property_value[PROPERTY_VALUE_MAX] = {0};
+    property_get("persist.dash.debug.level", property_value, NULL);
+
+    if(*property_value) {
+        mLogLevel = atoi(property_value);
+    }
+}
+
+DashPlayer::CaptionExtractor::~CaptionExtractor() {
+}
+
+void DashPlayer::CaptionExtractor::init() {
+    mLooper->registerHandler(this);
+}
+
+sp<AMessage> DashPlayer::CaptionExtractor::extract(
+        const sp<ABuffer> &buffer,
+        const sp<BufferInfo> &info,
+        int32_t width, int32_t height, int32_t colorFormat,
+        int32_t generation,
+        const sp<AMessage> &notifyConsumed) {
+    // The decoder reuses the BufferInfo once the frame is returned, so take
+    // a snapshot of what the extraction needs.
+    sp<AMessage> msg = new AMessage(kWhatExtract, id());
+    msg->setObject("graphic-buffer", info->mGraphicBuffer);
+    msg->setInt64("timeUs", info->mTimeUs);
+    msg->setSize("offset", buffer->offset());
+    msg->setInt32("width", width);
+    msg->setInt32("height", height);
+    msg->setInt32("color-format", colorFormat);
+    msg->setInt32("generation", generation);
+    msg->post();
+
+    // Posted after kWhatExtract to the same looper, so it is handled only
+    // once the frame's extradata has been read.
+    sp<AMessage> consumed = new AMessage(kWhatFrameConsumed, id());
+    consumed->setMessage("reply", notifyConsumed);
+    return consumed;
+}
+
+void DashPlayer::CaptionExtractor::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatExtract:
+        {
+            onExtract(msg);
+            break;
+        }
+
+        case kWhatFrameConsumed:
+        {
+            onFrameConsumed(msg);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+void DashPlayer::CaptionExtractor::onFrameConsumed(const sp<AMessage> &msg) {
+    sp<AMessage> reply;
+    CHECK(msg->findMessage("reply", &reply));
+
+    int32_t render;
+    if (msg->findInt32("render", &render)) {
+        reply->setInt32("render", render);
+    }
+    int64_t timestampNs;
+    if (msg->findInt64("timestampNs", &timestampNs)) {
+        reply->setInt64("timestampNs", timestampNs);
+    }
+    reply->post();
+}
+
+void DashPlayer::CaptionExtractor::onExtract(const sp<AMessage> &msg) {
+    sp<RefBase> obj;
+    CHECK(msg->findObject("graphic-buffer", &obj));
+    sp<GraphicBuffer> graphicBuffer = static_cast<GraphicBuffer *>(obj.get());
+    if (graphicBuffer == NULL) {
+        return;
+    }
+
+    int64_t timeUs;
+    size_t offset;
+    int32_t width, height, colorFormat, generation;
+    CHECK(msg->findInt64("timeUs", &timeUs));
+    CHECK(msg->findSize("offset", &offset));
+    CHECK(msg->findInt32("width", &width));
+    CHECK(msg->findInt32("height", &height));
+    CHECK(msg->findInt32("color-format", &colorFormat));
+    CHECK(msg->findInt32("generation", &generation));
+
+    DPC_MSG_LOW("Extradata present graphicBuffer = %p, width=%d height=%d color-format=%d",
+            graphicBuffer.get(), width, height, colorFormat);
+
+    if (colorFormat != 0x7FA30C04 /*OMX_QCOM_COLOR_FormatYUV420PackedSemiPlanar32m*/) {
+        return;
+    }
+
+    size_t filledLen = (VENUS_Y_STRIDE(COLOR_FMT_NV12, width)
+                        * VENUS_Y_SCANLINES(COLOR_FMT_NV12, height))
+                              +  (VENUS_UV_STRIDE(COLOR_FMT_NV12, width)
+                                  * VENUS_UV_SCANLINES(COLOR_FMT_NV12, height));
+    size_t allocLen = VENUS_BUFFER_SIZE(COLOR_FMT_NV12, width, height);
+
+    DPC_MSG_LOW("decoded buffer ranges "
+      "filledLen = %lu, allocLen = %lu, startOffset = %lu",
+      filledLen, allocLen, offset);
+
+    // 'lock' returns mapped virtual address that can be read from or written into
+    //  Use GRALLOC_USAGE_SW_READ_MASK / WRITE_MASK to indicate access type
+    // 'unlock' will unmap the mapped address.
+    // Only the extradata past the pixel planes is read.
+
+    void *yuvData = NULL;
+    graphicBuffer->lock(GRALLOC_USAGE_SW_READ_MASK, &yuvData);
+
+    if (yuvData == NULL) {
+        return;
+    }
+
+    OMX_OTHER_EXTRADATATYPE *pExtra;
+    pExtra = (OMX_OTHER_EXTRADATATYPE *)((unsigned long)((OMX_U8*)yuvData + offset + filledLen + 3)&(~3));
+
+    while (pExtra &&
+        ((OMX_U8*)pExtra + pExtra->nSize) <= ((OMX_U8*)yuvData + allocLen) &&
+        pExtra->eType != OMX_ExtraDataNone )
+    {
+        DPC_MSG_LOW(
+          "============== Extra Data ==============\n"
+          "           Size: %lu\n"
+          "        Version: %lu\n"
+          "      PortIndex: %lu\n"
+          "           Type: %x\n"
+          "       DataSize: %lu",
+          pExtra->nSize, pExtra->nVersion.nVersion,
+          pExtra->nPortIndex, pExtra->eType, pExtra->nDataSize);
+
+        if(pExtra->eType == (OMX_EXTRADATATYPE) OMX_ExtraDataMP2UserData)
+        {
+          OMX_QCOM_EXTRADATA_USERDATA *userdata = (OMX_QCOM_EXTRADATA_USERDATA *)pExtra->data;
+          OMX_U8 *data_ptr = (OMX_U8 *)userdata->data;
+          OMX_U32 userdata_size = 0;
+          if (pExtra->nDataSize > (OMX_U32)sizeof(userdata->type)) {
+              userdata_size = pExtra->nDataSize - (OMX_U32)sizeof(userdata->type);
+          }
+
+          DPC_MSG_LOW(
+            "--------------  OMX_ExtraDataMP2UserData Userdata  -------------\n"
+            "    Stream userdata type: %lu\n"
+            "           userdata size: %lu\n"
+            "         STREAM_USERDATA:",
+            userdata->type, userdata_size);
+
+          for (uint32_t i = 0; i + 3 < userdata_size; i+=4) {
+            DPC_MSG_LOW("        %x %x %x %x",
+              data_ptr[i], data_ptr[i+1],
+              data_ptr[i+2], data_ptr[i+3]);
+          }
+
+          DPC_MSG_LOW(
+            "-------------- End of OMX_ExtraDataMP2UserData Userdata -----------");
+
+          // Every user data block is checked, a frame may carry more than
+          // one caption payload.
+          const uint8_t *ccData;
+          size_t ccDataSize;
+          if (FindCEACCData(data_ptr, userdata_size, &ccData, &ccDataSize))
+          {
+            DPC_MSG_HIGH("SEI payload user_data_type_code is CEA encoded MPEG_cc_data(), "
+                "cc_data ptr: %p cc_data_size: %zu", ccData, ccDataSize);
+
+            // The mapping goes away on unlock, hand over a copy.
+            sp<ABuffer> accessUnit = new ABuffer(ccDataSize);
+            memcpy(accessUnit->data(), ccData, ccDataSize);
+            accessUnit->meta()->setInt64("timeUs", timeUs);
+
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatCaptionData);
+            notify->setInt32("generation", generation);
+            notify->setBuffer("buffer", accessUnit);
+            notify->post();
+          }
+        }
+
+        pExtra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) pExtra) + pExtra->nSize);
+    }
+
+    graphicBuffer->unlock();
+}
+
+}  // namespace android
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASHPLAYER_CAPTION_EXTRACTOR_H_
+
+#define DASHPLAYER_CAPTION_EXTRACTOR_H_
+
+#include "DashPlayer.h"
+#include <media/stagefright/foundation/AHandler.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Pulls CEA-608/708 cc_data out of the extradata that trails decoded video
+// frames, on its own looper so the frame itself goes to the renderer right
+// away. The decoder must not get a frame back while it is being read, so
+// the renderer's "consumed" notification is routed through this handler
+// and forwarded only once extraction for that frame is done.
+struct DashPlayer::CaptionExtractor : public AHandler {
+    CaptionExtractor(const sp<AMessage> &notify);
+
+    void init();
+
+    // Queues cc_data extraction for a decoded frame. Returns the message
+    // the renderer should post once it is done with the frame, in place
+    // of notifyConsumed.
+    sp<AMessage> extract(
+            const sp<ABuffer> &buffer,
+            const sp<BufferInfo> &info,
+            int32_t width, int32_t height, int32_t colorFormat,
+            int32_t generation,
+            const sp<AMessage> &notifyConsumed);
+
+    enum {
+        kWhatCaptionData        = 'ccDt',
+    };
+
+protected:
+    virtual ~CaptionExtractor();
+
+    virtual void onMessageReceived(const sp<AMessage> &msg);
+
+private:
+    enum {
+        kWhatExtract            = 'extr',
+        kWhatFrameConsumed      = 'frmC',
+    };
+
+    sp<AMessage> mNotify;
+    sp<ALooper> mLooper;
+
+    int mLogLevel;
+
+    void onExtract(const sp<AMessage> &msg);
+    void onFrameConsumed(const sp<AMessage> &msg);
+
+    DISALLOW_EVIL_CONSTRUCTORS(CaptionExtractor);
+};
+
+}  // namespace android
+
+#endif  // DASHPLAYER_CAPTION_EXTRACTOR_H_
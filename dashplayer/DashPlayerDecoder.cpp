@@ -42,11 +42,34 @@
 
 namespace android {
 
+// Buffers per direction handled for one codec notification by default.
+static const size_t kDefaultDrainBudget = 16;
+
+// Access unit buffers cycled in offload mode, each holds one compressed
+// audio frame.
+static const size_t kNumOffloadBuffers = 16;
+static const size_t kOffloadBufferSize = 16 * 1024;
+
+// Bound on the inputs tracked for decode latency, entries the codec never
+// returned (dropped or merged frames) are evicted oldest first.
+static const size_t kMaxTrackedInputs = 64;
+
 DashPlayer::Decoder::Decoder(
         const sp<AMessage> &notify,
         const sp<NativeWindowWrapper> &nativeWindow)
     : mNotify(notify),
       mNativeWindow(nativeWindow),
+      mIsAsync(true),
+      mPaused(false),
+      mOffload(false),
+      mParked(false),
+      mSkipOutputUntilUs(-1ll),
+      mNumSkippedOutputs(0),
+      mDrainBudget(kDefaultDrainBudget),
+      mDrainCallbacksPending(false),
+      mNumWakeups(0),
+      mNumBuffersDrained(0),
+      mMaxBuffersPerWakeup(0),
       mLogLevel(0),
       mBufferGeneration(0),
       mComponentName("decoder") {
@@ -66,6 +89,20 @@ DashPlayer::Decoder::Decoder(
       if(*property_value) {
           mLogLevel = atoi(property_value);
       }
+
+      // MediaCodec callbacks push buffer availability to us, setting this
+      // to 0 falls back to polling through activity notifications.
+      property_value[0] = '\0';
+      property_get("persist.dash.decoder.async", property_value, NULL);
+      if(*property_value) {
+          mIsAsync = atoi(property_value) != 0;
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.decoder.drain.budget", property_value, NULL);
+      if(*property_value && atoi(property_value) > 0) {
+          mDrainBudget = atoi(property_value);
+      }
 }
 
 DashPlayer::Decoder::~Decoder() {
@@ -77,9 +114,13 @@ DashPlayer::Decoder::~Decoder() {
  *
  */
 void DashPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
-    CHECK(mCodec == NULL);
+    CHECK(mCodec == NULL || mParked);
 
+    int64_t startUs = ALooper::GetNowUs();
+    bool warm = mParked;
+    mParked = false;
     ++mBufferGeneration;
+    dropPendingCallbacks();
 
     AString mime;
     CHECK(format->findString("mime", &mime));
@@ -89,19 +130,25 @@ void DashPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
         surface = mNativeWindow->getSurfaceTextureClient();
     }
 
-    mComponentName = mime;
-    mComponentName.append(" decoder");
-    DPD_MSG_HIGH("[%s] onConfigure (surface=%p)", mComponentName.c_str(), surface.get());
+    if (warm) {
+        // stopped by initiateParking(), the component is still allocated
+        DPD_MSG_HIGH("[%s] onConfigure in place (surface=%p)",
+                mComponentName.c_str(), surface.get());
+    } else {
+        mComponentName = mime;
+        mComponentName.append(" decoder");
+        DPD_MSG_HIGH("[%s] onConfigure (surface=%p)", mComponentName.c_str(), surface.get());
+
+        mCodec = MediaCodec::CreateByType(mCodecLooper, mime.c_str(), false /* encoder */);
+        if (mCodec == NULL) {
+            DPD_MSG_ERROR("Failed to create %s decoder", mime.c_str());
+            handleError(UNKNOWN_ERROR);
+            return;
+        }
 
-    mCodec = MediaCodec::CreateByType(mCodecLooper, mime.c_str(), false /* encoder */);
-    if (mCodec == NULL) {
-        DPD_MSG_ERROR("Failed to create %s decoder", mime.c_str());
-        handleError(UNKNOWN_ERROR);
-        return;
+        mCodec->getName(&mComponentName);
     }
 
-    mCodec->getName(&mComponentName);
-
     status_t err;
     if (mNativeWindow != NULL) {
         // disconnect from surface as MediaCodec will reconnect
@@ -112,6 +159,15 @@ void DashPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
         // any error signaling will occur.
         ALOGW_IF(err != OK, "failed to disconnect from surface: %d", err);
     }
+    if (mIsAsync) {
+        err = mCodec->setCallback(new AMessage(kWhatCodecCallback, id()));
+        if (err != OK) {
+            DPD_MSG_ERROR("[%s] async mode not available (err=%d), polling",
+                    mComponentName.c_str(), err);
+            mIsAsync = false;
+        }
+    }
+
     err = mCodec->configure(
             format, surface, NULL /* crypto */, 0 /* flags */);
     if (err != OK) {
@@ -130,9 +186,24 @@ void DashPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
         return;
     }
 
+    mPaused = false;
+    DPD_MSG_HIGH("[%s] %s configure took %lld us", mComponentName.c_str(),
+            warm ? "warm" : "cold", (long long)(ALooper::GetNowUs() - startUs));
+
+    if (mIsAsync) {
+        // Buffers are looked up by index as the callbacks announce them.
+        mInputBuffers.clear();
+        mOutputBuffers.clear();
+        allocateOutputBufferInfos();
+        resetMessagePools();
+        return;
+    }
+
     // the following should work after start
     CHECK_EQ((status_t)OK, mCodec->getInputBuffers(&mInputBuffers));
     CHECK_EQ((status_t)OK, mCodec->getOutputBuffers(&mOutputBuffers));
+    allocateOutputBufferInfos();
+    resetMessagePools();
     DPD_MSG_HIGH("[%s] got %zu input and %zu output buffers",
             mComponentName.c_str(),
             mInputBuffers.size(),
@@ -141,19 +212,171 @@ void DashPlayer::Decoder::onConfigure(const sp<AMessage> &format) {
     requestCodecNotification();
 }
 
+/** @brief: set up passthrough of compressed access units for offload
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onConfigureOffload(const sp<AMessage> &format) {
+    CHECK(mCodec == NULL);
+
+    ++mBufferGeneration;
+    dropPendingCallbacks();
+
+    AString mime;
+    CHECK(format->findString("mime", &mime));
+
+    mComponentName = mime;
+    mComponentName.append(" offload");
+    DPD_MSG_HIGH("[%s] onConfigureOffload", mComponentName.c_str());
+
+    mOffload = true;
+    mIsAsync = false;
+    mPaused = false;
+
+    mInputBuffers.clear();
+    for (size_t i = 0; i < kNumOffloadBuffers; ++i) {
+        mInputBuffers.push(new ABuffer(kOffloadBufferSize));
+    }
+
+    // An access unit goes to the renderer in the buffer it was filled in.
+    mOutputBuffers = mInputBuffers;
+    allocateOutputBufferInfos();
+    resetMessagePools();
+
+    for (size_t i = 0; i < mInputBuffers.size(); ++i) {
+        onInputBufferAvailable(i);
+    }
+}
+
+/** @brief: allocate one BufferInfo per output buffer, reused for every frame
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::allocateOutputBufferInfos() {
+    mOutputBufferInfos.clear();
+    for (size_t i = 0; i < mOutputBuffers.size(); ++i) {
+        mOutputBufferInfos.push(new BufferInfo);
+    }
+}
+
+/** @brief: (re)create the per-index reply and notify messages
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::resetMessagePools() {
+    mInputReplies.clear();
+    mInputNotifies.clear();
+
+    for (size_t i = 0; i < mInputBuffers.size(); ++i) {
+        mInputReplies.push(new AMessage(kWhatInputBufferFilled, id()));
+        mInputNotifies.push(mNotify->dup());
+    }
+    DashPlayerStats::countMessageAllocations((int32_t)(2 * mInputBuffers.size()));
+
+    resetOutputMessagePool();
+}
+
+void DashPlayer::Decoder::resetOutputMessagePool() {
+    mOutputReplies.clear();
+    mOutputNotifies.clear();
+
+    for (size_t i = 0; i < mOutputBuffers.size(); ++i) {
+        mOutputReplies.push(new AMessage(kWhatRenderBuffer, id()));
+        mOutputNotifies.push(mNotify->dup());
+    }
+    DashPlayerStats::countMessageAllocations((int32_t)(2 * mOutputBuffers.size()));
+}
+
 /** @brief:  Register activity notification to mediacodec
  *
  *  @return: void
  *
  */
 void DashPlayer::Decoder::requestCodecNotification() {
-    if (mCodec != NULL) {
+    if (mCodec != NULL && !mParked) {
         sp<AMessage> reply = new AMessage(kWhatCodecNotify, id());
         reply->setInt32("generation", mBufferGeneration);
         mCodec->requestActivityNotification(reply);
     }
         }
 
+/** @brief: handle up to mDrainBudget ready input and output buffers each
+ *
+ *  @return: number of buffers handled
+ *
+ */
+size_t DashPlayer::Decoder::drainCodec() {
+    size_t numInput = 0;
+    while (numInput < mDrainBudget && handleAnInputBuffer()) {
+        ++numInput;
+    }
+
+    size_t numOutput = 0;
+    while (numOutput < mDrainBudget && handleAnOutputBuffer()) {
+        ++numOutput;
+    }
+
+    return numInput + numOutput;
+}
+
+/** @brief: hand on up to mDrainBudget queued codec callbacks, in the
+ *          order MediaCodec sent them
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onDrainCallbacks() {
+    mDrainCallbacksPending = false;
+
+    size_t numCallbacks = 0;
+    while (numCallbacks < mDrainBudget && !mPendingCallbacks.empty()) {
+        sp<AMessage> callback = mPendingCallbacks.front();
+        mPendingCallbacks.pop_front();
+        onCodecCallback(callback);
+        ++numCallbacks;
+    }
+
+    if (numCallbacks > 0) {
+        recordWakeup(numCallbacks);
+    }
+
+    if (!mPendingCallbacks.empty()) {
+        mDrainCallbacksPending = true;
+        mDrainCallbacksMsg->post();
+    }
+}
+
+// Callbacks still queued refer to buffers the codec reclaims on flush,
+// shutdown or configure.
+void DashPlayer::Decoder::dropPendingCallbacks() {
+    while (!mPendingCallbacks.empty()) {
+        mPendingCallbacks.pop_front();
+    }
+}
+
+void DashPlayer::Decoder::recordWakeup(size_t numBuffers) {
+    ++mNumWakeups;
+    mNumBuffersDrained += numBuffers;
+    if (numBuffers > mMaxBuffersPerWakeup) {
+        mMaxBuffersPerWakeup = numBuffers;
+    }
+}
+
+void DashPlayer::Decoder::logAndResetDrainStats() {
+    if (mNumWakeups > 0) {
+        DPD_MSG_HIGH("[%s] %llu buffers in %u wakeups (avg %.2f, max %zu)",
+                mComponentName.c_str(), (unsigned long long)mNumBuffersDrained,
+                mNumWakeups, (double)mNumBuffersDrained / mNumWakeups,
+                mMaxBuffersPerWakeup);
+    }
+    mNumWakeups = 0;
+    mNumBuffersDrained = 0;
+    mMaxBuffersPerWakeup = 0;
+}
+
 bool DashPlayer::Decoder::isStaleReply(const sp<AMessage> &msg) {
     int32_t generation;
     CHECK(msg->findInt32("generation", &generation));
@@ -170,9 +393,24 @@ void DashPlayer::Decoder::init() {
  *
  */
 void DashPlayer::Decoder::configure(const sp<MetaData> &meta) {
+    mPoolKey = GetPoolKey(meta);
+    sp<AMessage> msg = new AMessage(kWhatConfigure, id());
+    sp<AMessage> format = makeFormat(meta);
+    msg->setMessage("format", format);
+    msg->post();
+}
+
+/** @brief: configure decoder for compressed audio offload
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::configureForOffload(const sp<MetaData> &meta) {
+    mPoolKey = GetPoolKey(meta);
     sp<AMessage> msg = new AMessage(kWhatConfigure, id());
     sp<AMessage> format = makeFormat(meta);
     msg->setMessage("format", format);
+    msg->setInt32("offload", 1);
     msg->post();
 }
 
@@ -206,18 +444,51 @@ bool DashPlayer::Decoder::handleAnInputBuffer() {
         return false;
     }
 
+    onInputBufferAvailable(bufferIx);
+    return true;
+}
+
+/** @brief: hand an available input buffer to dashplayer for filling
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onInputBufferAvailable(size_t bufferIx) {
+    if (mIsAsync) {
+        while (mInputBuffers.size() <= bufferIx) {
+            mInputBuffers.push(NULL);
+        }
+
+        sp<ABuffer> buffer;
+        status_t err = mCodec->getInputBuffer(bufferIx, &buffer);
+        if (err != OK || buffer == NULL) {
+            DPD_MSG_ERROR("[%s] failed to get input buffer %zu (err=%d)",
+                    mComponentName.c_str(), bufferIx, err);
+            handleError(err != OK ? err : UNKNOWN_ERROR);
+            return;
+        }
+        mInputBuffers.editItemAt(bufferIx) = buffer;
+
+        while (mInputReplies.size() <= bufferIx) {
+            mInputReplies.push(new AMessage(kWhatInputBufferFilled, id()));
+            mInputNotifies.push(mNotify->dup());
+            DashPlayerStats::countMessageAllocations(2);
+        }
+    }
+
     CHECK_LT(bufferIx, mInputBuffers.size());
 
-    sp<AMessage> reply = new AMessage(kWhatInputBufferFilled, id());
+    // DashPlayer sets "buffer" or "err" on the reply, start from scratch.
+    sp<AMessage> reply = mInputReplies[bufferIx];
+    reply->clear();
     reply->setSize("buffer-ix", bufferIx);
     reply->setInt32("generation", mBufferGeneration);
 
-    sp<AMessage> notify = mNotify->dup();
+    sp<AMessage> notify = mInputNotifies[bufferIx];
     notify->setInt32("what", kWhatFillThisBuffer);
     notify->setBuffer("buffer", mInputBuffers[bufferIx]);
     notify->setMessage("reply", reply);
     notify->post();
-    return true;
 }
 
 /** @brief: Send input buffer to  decoder
@@ -242,6 +513,19 @@ void android::DashPlayer::Decoder::onInputBufferFilled(const sp<AMessage> &msg)
             return;
         }
 
+        if (mOffload) {
+            // nothing left to decode, EOS goes straight to the renderer
+            if (streamErr != ERROR_END_OF_STREAM) {
+                handleError(streamErr);
+                return;
+            }
+            sp<AMessage> notify = mNotify->dup();
+            notify->setInt32("what", kWhatEOS);
+            notify->setInt32("err", ERROR_END_OF_STREAM);
+            notify->post();
+            return;
+        }
+
         // attempt to queue EOS
         status_t err = mCodec->queueInputBuffer(
                 bufferIx,
@@ -277,6 +561,26 @@ void android::DashPlayer::Decoder::onInputBufferFilled(const sp<AMessage> &msg)
             memcpy(codecBuffer->data(), buffer->data(), buffer->size());
         }
 
+        if (mOffload) {
+            // the access unit is the output, EOS is signalled after it
+            onOutputBufferAvailable(
+                    bufferIx, codecBuffer->offset(), codecBuffer->size(), timeUs, 0);
+            if (flags & MediaCodec::BUFFER_FLAG_EOS) {
+                sp<AMessage> notify = mNotify->dup();
+                notify->setInt32("what", kWhatEOS);
+                notify->setInt32("err", ERROR_END_OF_STREAM);
+                notify->post();
+            }
+            return;
+        }
+
+        if (mNativeWindow != NULL) {
+            if (mInputQueuedAtUs.size() >= kMaxTrackedInputs) {
+                mInputQueuedAtUs.removeItemsAt(0);
+            }
+            mInputQueuedAtUs.add(timeUs, ALooper::GetNowUs());
+        }
+
         status_t err = mCodec->queueInputBuffer(
                         bufferIx,
                         codecBuffer->offset(),
@@ -320,6 +624,9 @@ bool DashPlayer::Decoder::handleAnOutputBuffer() {
             handleError(res);
             return false;
         }
+        allocateOutputBufferInfos();
+        // All old output buffers have been returned by now.
+        resetOutputMessagePool();
         // DashPlayer ignores this
         return true;
     } else if (res == INFO_FORMAT_CHANGED) {
@@ -332,10 +639,7 @@ bool DashPlayer::Decoder::handleAnOutputBuffer() {
             return false;
         }
 
-        sp<AMessage> notify = mNotify->dup();
-        notify->setInt32("what", kWhatOutputFormatChanged);
-        notify->setMessage("format", format);
-        notify->post();
+        onOutputFormatChanged(format);
         return true;
     } else if (res == INFO_DISCONTINUITY) {
         // nothing to do
@@ -347,6 +651,30 @@ bool DashPlayer::Decoder::handleAnOutputBuffer() {
         return false;
     }
 
+    onOutputBufferAvailable(bufferIx, offset, size, timeUs, flags);
+    return true;
+}
+
+/** @brief: notify dashplayer of a new decoder output format
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onOutputFormatChanged(const sp<AMessage> &format) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatOutputFormatChanged);
+    notify->setMessage("format", format);
+    notify->post();
+}
+
+/** @brief: send a decoded buffer from codec to dashplayer
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onOutputBufferAvailable(
+        size_t bufferIx, size_t offset, size_t size,
+        int64_t timeUs, uint32_t flags) {
     // FIXME: This should be handled after rendering is complete,
     // but Renderer needs it now
     if (flags & MediaCodec::BUFFER_FLAG_EOS) {
@@ -364,41 +692,93 @@ bool DashPlayer::Decoder::handleAnOutputBuffer() {
         notify->setInt32("what", kWhatEOS);
         notify->setInt32("err", ERROR_END_OF_STREAM);
         notify->post();
-        return true;
+        return;
+    }
+
+    if (mSkipOutputUntilUs >= 0 && !mOffload) {
+        if (timeUs < mSkipOutputUntilUs) {
+            ssize_t queuedIx = mInputQueuedAtUs.indexOfKey(timeUs);
+            if (queuedIx >= 0) {
+                mInputQueuedAtUs.removeItemsAt(queuedIx);
+            }
+            ++mNumSkippedOutputs;
+
+            status_t err = mCodec->releaseOutputBuffer(bufferIx);
+            if (err != OK) {
+                DPD_MSG_ERROR("failed to release output buffer for %s (err=%d)",
+                        mComponentName.c_str(), err);
+                handleError(err);
+            }
+            return;
+        }
+
+        DPD_MSG_HIGH("[%s] skipped %u frames before %lld us",
+                mComponentName.c_str(), mNumSkippedOutputs, (long long)mSkipOutputUntilUs);
+        mSkipOutputUntilUs = -1ll;
+        mNumSkippedOutputs = 0;
+    }
+
+    if (mIsAsync) {
+        while (mOutputBuffers.size() <= bufferIx) {
+            mOutputBuffers.push(NULL);
+            mOutputBufferInfos.push(new BufferInfo);
+            mOutputReplies.push(new AMessage(kWhatRenderBuffer, id()));
+            mOutputNotifies.push(mNotify->dup());
+            DashPlayerStats::countMessageAllocations(2);
+        }
+
+        sp<ABuffer> outBuffer;
+        status_t err = mCodec->getOutputBuffer(bufferIx, &outBuffer);
+        if (err != OK || outBuffer == NULL) {
+            DPD_MSG_ERROR("[%s] failed to get output buffer %zu (err=%d)",
+                    mComponentName.c_str(), bufferIx, err);
+            handleError(err != OK ? err : UNKNOWN_ERROR);
+            return;
+        }
+        mOutputBuffers.editItemAt(bufferIx) = outBuffer;
     }
 
     CHECK_LT(bufferIx, mOutputBuffers.size());
     sp<ABuffer> buffer = mOutputBuffers[bufferIx];
     buffer->setRange(offset, size);
 
-    sp<RefBase> obj;
-    sp<GraphicBuffer> graphicBuffer;
-    if (buffer->meta()->findObject("graphic-buffer", &obj)) {
-        graphicBuffer = static_cast<GraphicBuffer*>(obj.get());
+    // An output buffer is only dequeued again after DashPlayer returned it,
+    // so its info object can be reused for the next frame.
+    sp<BufferInfo> info = mOutputBufferInfos[bufferIx];
+    info->mTimeUs = timeUs;
+    info->mFlags = 0;
+    info->mDecodeLatencyUs = -1;
+    info->mGraphicBuffer.clear();
+
+    ssize_t queuedIx = mInputQueuedAtUs.indexOfKey(timeUs);
+    if (queuedIx >= 0) {
+        info->mDecodeLatencyUs =
+            ALooper::GetNowUs() - mInputQueuedAtUs.valueAt(queuedIx);
+        mInputQueuedAtUs.removeItemsAt(queuedIx);
     }
 
-    buffer->meta()->clear();
-    buffer->meta()->setInt64("timeUs", timeUs);
-    if (flags & MediaCodec::BUFFER_FLAG_EOS) {
-        buffer->meta()->setInt32("eos", true);
-    }
     // we do not expect CODECCONFIG or SYNCFRAME for decoder
+    if (flags & MediaCodec::BUFFER_FLAG_EXTRADATA) {
+        info->mFlags |= BufferInfo::FLAG_EXTRADATA;
 
-    sp<AMessage> reply = new AMessage(kWhatRenderBuffer, id());
+        // Only the caption parser needs CPU access to the frame.
+        sp<RefBase> obj;
+        if (buffer->meta()->findObject("graphic-buffer", &obj)) {
+            info->mGraphicBuffer = static_cast<GraphicBuffer*>(obj.get());
+        }
+    }
+    // The renderer sets "render" on the reply, start from scratch.
+    sp<AMessage> reply = mOutputReplies[bufferIx];
+    reply->clear();
     reply->setSize("buffer-ix", bufferIx);
     reply->setInt32("generation", mBufferGeneration);
 
-    sp<AMessage> notify = mNotify->dup();
+    sp<AMessage> notify = mOutputNotifies[bufferIx];
     notify->setInt32("what", kWhatDrainThisBuffer);
-    if(flags & MediaCodec::BUFFER_FLAG_EXTRADATA) {
-       buffer->meta()->setInt32("extradata", 1);
-    }
-    buffer->meta()->setObject("graphic-buffer", graphicBuffer);
     notify->setBuffer("buffer", buffer);
+    notify->setObject("info", info);
     notify->setMessage("reply", reply);
     notify->post();
-
-    return true;
 }
 
 /** @brief: Give buffer to mediacodec for rendering
@@ -411,8 +791,20 @@ void DashPlayer::Decoder::onRenderBuffer(const sp<AMessage> &msg) {
     int32_t render;
     size_t bufferIx;
     CHECK(msg->findSize("buffer-ix", &bufferIx));
+    if (mOffload) {
+        // the renderer is done with the access unit, refill the buffer
+        onInputBufferAvailable(bufferIx);
+        return;
+    }
+
+    int64_t timestampNs;
     if (msg->findInt32("render", &render) && render) {
-        err = mCodec->renderOutputBufferAndRelease(bufferIx);
+        if (msg->findInt64("timestampNs", &timestampNs)) {
+            // the renderer picked the vsync to show this frame at
+            err = mCodec->renderOutputBufferAndRelease(bufferIx, timestampNs);
+        } else {
+            err = mCodec->renderOutputBufferAndRelease(bufferIx);
+        }
     } else {
         err = mCodec->releaseOutputBuffer(bufferIx);
     }
@@ -429,10 +821,28 @@ void DashPlayer::Decoder::onRenderBuffer(const sp<AMessage> &msg) {
  *
  */
 void DashPlayer::Decoder::onFlush() {
+    logAndResetDrainStats();
+    dropPendingCallbacks();
+    mInputQueuedAtUs.clear();
+    mSkipOutputUntilUs = -1ll;
+    mNumSkippedOutputs = 0;
+
     status_t err = OK;
     if (mCodec != NULL) {
         err = mCodec->flush();
         ++mBufferGeneration;
+        resetMessagePools();
+
+        // In async mode the codec stays idle until signalResume().
+        if (mIsAsync) {
+            mPaused = true;
+        }
+    } else if (mOffload) {
+        // access units held by DashPlayer or the renderer come back stale,
+        // all buffers are requested again on signalResume()
+        ++mBufferGeneration;
+        resetMessagePools();
+        mPaused = true;
     }
 
     if (err != OK) {
@@ -446,20 +856,139 @@ void DashPlayer::Decoder::onFlush() {
     notify->post();
 }
 
-/** @brief: notify decoder shutdown complete to dashplayer
+/** @brief: restart an async codec after flush
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onResume() {
+    if (mOffload) {
+        if (mPaused) {
+            mPaused = false;
+            for (size_t i = 0; i < mInputBuffers.size(); ++i) {
+                onInputBufferAvailable(i);
+            }
+        }
+        return;
+    }
+
+    if (!mIsAsync || !mPaused || mCodec == NULL) {
+        return;
+    }
+
+    status_t err = mCodec->start();
+    if (err != OK) {
+        DPD_MSG_ERROR("failed to resume %s (err=%d)", mComponentName.c_str(), err);
+        handleError(err);
+        return;
+    }
+    mPaused = false;
+}
+
+/** @brief: dispatch a MediaCodec async callback
  *
  *  @return: void
  *
  */
-void DashPlayer::Decoder::onShutdown() {
+void DashPlayer::Decoder::onCodecCallback(const sp<AMessage> &msg) {
+    // Callbacks queued before a flush or shutdown refer to buffers the
+    // codec has already reclaimed.
+    if (mPaused || mCodec == NULL) {
+        return;
+    }
+
+    int32_t cbID;
+    CHECK(msg->findInt32("callbackID", &cbID));
+
+    switch (cbID) {
+        case MediaCodec::CB_INPUT_AVAILABLE:
+        {
+            int32_t index;
+            CHECK(msg->findInt32("index", &index));
+            onInputBufferAvailable(index);
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_AVAILABLE:
+        {
+            int32_t index;
+            size_t offset;
+            size_t size;
+            int64_t timeUs;
+            int32_t flags;
+            CHECK(msg->findInt32("index", &index));
+            CHECK(msg->findSize("offset", &offset));
+            CHECK(msg->findSize("size", &size));
+            CHECK(msg->findInt64("timeUs", &timeUs));
+            CHECK(msg->findInt32("flags", &flags));
+            onOutputBufferAvailable(index, offset, size, timeUs, flags);
+            break;
+        }
+
+        case MediaCodec::CB_OUTPUT_FORMAT_CHANGED:
+        {
+            sp<AMessage> format;
+            CHECK(msg->findMessage("format", &format));
+            onOutputFormatChanged(format);
+            break;
+        }
+
+        case MediaCodec::CB_ERROR:
+        {
+            status_t err;
+            CHECK(msg->findInt32("err", &err));
+            DPD_MSG_ERROR("[%s] codec error (err=%d)", mComponentName.c_str(), err);
+            handleError(err);
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+/** @brief: release or park the codec, notify shutdown complete to dashplayer
+ *
+ *  @return: void
+ *
+ */
+void DashPlayer::Decoder::onShutdown(bool keepComponent, bool retired) {
+    logAndResetDrainStats();
+    dropPendingCallbacks();
+    mInputQueuedAtUs.clear();
+    mSkipOutputUntilUs = -1ll;
+    mNumSkippedOutputs = 0;
+
+    bool wasParked = mParked;
+    mParked = false;
+
     status_t err = OK;
     if (mCodec != NULL) {
-        err = mCodec->release();
-        mCodec = NULL;
+        if (keepComponent) {
+            // a parked codec is stopped already
+            err = wasParked ? (status_t)OK : mCodec->stop();
+            if (err == OK) {
+                mParked = true;
+            } else {
+                DPD_MSG_ERROR("failed to stop %s (err=%d), releasing it",
+                        mComponentName.c_str(), err);
+            }
+        }
+        if (!mParked) {
+            err = mCodec->release();
+            mCodec = NULL;
+        }
         ++mBufferGeneration;
 
-        if (mNativeWindow != NULL) {
-            // reconnect to surface as MediaCodec disconnected from it
+        // callbacks still queued refer to the stopped codec's buffers
+        mPaused = true;
+        mInputBuffers.clear();
+        mOutputBuffers.clear();
+
+        if (mNativeWindow != NULL && !wasParked) {
+            // reconnect to surface as MediaCodec disconnected from it,
+            // a parked codec had already been disconnected when stopped
             status_t error =
                     native_window_api_connect(
                             mNativeWindow->getNativeWindow().get(),
@@ -468,17 +997,34 @@ void DashPlayer::Decoder::onShutdown() {
                     "[%s] failed to connect to native window, error=%d",
                     mComponentName.c_str(), error);
         }
+        if (!mParked) {
+            mComponentName = "decoder";
+        }
+    } else if (mOffload) {
+        ++mBufferGeneration;
+        mOffload = false;
+        mInputBuffers.clear();
+        mOutputBuffers.clear();
         mComponentName = "decoder";
     }
 
     if (err != OK) {
         DPD_MSG_ERROR("failed to release %s (err=%d)", mComponentName.c_str(), err);
-        handleError(err);
+        // playback no longer depends on a retired decoder
+        if (!retired) {
+            handleError(err);
+        }
         // finish with posting kWhatShutdownCompleted.
     }
 
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatShutdownCompleted);
+    notify->setInt32("parked", mParked);
+    if (retired) {
+        // dashplayer no longer tracks it, the last reference comes along
+        notify->setInt32("retired", 1);
+        notify->setObject("decoder", this);
+    }
     notify->post();
 }
 
@@ -495,21 +1041,44 @@ void DashPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
         {
             sp<AMessage> format;
             CHECK(msg->findMessage("format", &format));
-            onConfigure(format);
+            int32_t offload;
+            if (msg->findInt32("offload", &offload) && offload) {
+                onConfigureOffload(format);
+            } else {
+                onConfigure(format);
+            }
             break;
         }
 
         case kWhatCodecNotify:
         {
             if (!isStaleReply(msg)) {
-                while (handleAnInputBuffer()) {
-                }
+                recordWakeup(drainCodec());
+            }
 
-                while (handleAnOutputBuffer()) {
+            // Fires right away if the budget left buffers behind.
+            requestCodecNotification();
+            break;
+        }
+
+        case kWhatCodecCallback:
+        {
+            // Each callback is its own message, so queue them and hand
+            // them on together once the looper gets to the drain.
+            mPendingCallbacks.push_back(msg);
+            if (!mDrainCallbacksPending) {
+                if (mDrainCallbacksMsg == NULL) {
+                    mDrainCallbacksMsg = new AMessage(kWhatDrainCallbacks, id());
                 }
+                mDrainCallbacksPending = true;
+                mDrainCallbacksMsg->post();
             }
+            break;
+        }
 
-            requestCodecNotification();
+        case kWhatDrainCallbacks:
+        {
+            onDrainCallbacks();
             break;
         }
 
@@ -535,9 +1104,26 @@ void DashPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
             break;
             }
 
+        case kWhatResume:
+        {
+            onResume();
+            break;
+        }
+
+        case kWhatSetSkipOutputUntil:
+        {
+            CHECK(msg->findInt64("timeUs", &mSkipOutputUntilUs));
+            mNumSkippedOutputs = 0;
+            break;
+        }
+
         case kWhatShutdown:
         {
-            onShutdown();
+            int32_t keepComponent = 0;
+            msg->findInt32("keep-component", &keepComponent);
+            int32_t retired = 0;
+            msg->findInt32("retired", &retired);
+            onShutdown(keepComponent != 0, retired != 0);
             break;
         }
 
@@ -552,13 +1138,61 @@ void DashPlayer::Decoder::signalFlush() {
 }
 
 void DashPlayer::Decoder::signalResume() {
-    // nothing to do
+    (new AMessage(kWhatResume, id()))->post();
 }
 
 void DashPlayer::Decoder::initiateShutdown() {
     (new AMessage(kWhatShutdown, id()))->post();
 }
 
+void DashPlayer::Decoder::setSkipOutputUntil(int64_t timeUs) {
+    sp<AMessage> msg = new AMessage(kWhatSetSkipOutputUntil, id());
+    msg->setInt64("timeUs", timeUs);
+    msg->post();
+}
+
+void DashPlayer::Decoder::initiateParking() {
+    sp<AMessage> msg = new AMessage(kWhatShutdown, id());
+    msg->setInt32("keep-component", 1);
+    msg->post();
+}
+
+void DashPlayer::Decoder::initiateRetirement(bool park) {
+    sp<AMessage> msg = new AMessage(kWhatShutdown, id());
+    msg->setInt32("keep-component", park);
+    msg->setInt32("retired", 1);
+    msg->post();
+}
+
+/** @brief: key of the components that can decode a format
+ *
+ *  @return: lower case mime, with "/" and the profile appended if known
+ *
+ */
+AString DashPlayer::Decoder::GetPoolKey(const sp<MetaData> &meta) {
+    const char *mime;
+    CHECK(meta->findCString(kKeyMIMEType, &mime));
+    AString key(mime);
+    key.tolower();
+
+    int32_t profile = -1;
+    uint32_t type;
+    const void *data;
+    size_t size;
+    if (meta->findInt32(kKeyAACProfile, &profile)) {
+        // as signalled by the source
+    } else if (meta->findData(kKeyAVCC, &type, &data, &size) && size > 1) {
+        // AVCProfileIndication of the decoder configuration record
+        profile = ((const uint8_t *)data)[1];
+    }
+
+    if (profile >= 0) {
+        key.append("/");
+        key.append(profile);
+    }
+    return key;
+}
+
 
 /** @brief: convert input metadat into AMessage format
  *
@@ -20,7 +20,9 @@
 
 #include "DashPlayerRenderer.h"
 #include "DashPlayer.h"
+#include "DashRingQueue.h"
 #include <media/stagefright/foundation/AHandler.h>
+#include <utils/KeyedVector.h>
 
 namespace android {
 
@@ -32,12 +34,37 @@ struct DashPlayer::Decoder : public AHandler {
             const sp<NativeWindowWrapper> &nativeWindow = NULL);
 
     void configure(const sp<MetaData> &meta);
+
+    // No codec is created, compressed access units are handed to the
+    // renderer as they are, for an AudioSink that decodes them itself.
+    void configureForOffload(const sp<MetaData> &meta);
     void init();
 
     void signalFlush();
     void signalResume();
     void initiateShutdown();
 
+    // Like initiateShutdown(), but the codec is only stopped, keeping its
+    // component allocated, and kWhatShutdownCompleted carries "parked".
+    // A parked decoder is started again by configure() with a format of
+    // the same pool key, without reallocating the component.
+    void initiateParking();
+
+    // Shuts down, or parks, a decoder dashplayer no longer plays from.
+    // kWhatShutdownCompleted then carries "retired" and the decoder itself
+    // as "decoder", and errors are not reported.
+    void initiateRetirement(bool park);
+
+    // Formats with equal keys (mime and, where the metadata carries it,
+    // profile) can be decoded by the same component.
+    static AString GetPoolKey(const sp<MetaData> &meta);
+    const AString &getPoolKey() const { return mPoolKey; }
+
+    // Output before timeUs is released unrendered right here instead of
+    // being sent to dashplayer, up to the first frame at or after it. A
+    // flush or shutdown cancels it.
+    void setSkipOutputUntil(int64_t timeUs);
+
 
     enum {
         kWhatFillThisBuffer      = 'flTB',
@@ -62,6 +89,10 @@ private:
         kWhatRenderBuffer       = 'rndr',
         kWhatFlush              = 'flus',
         kWhatShutdown           = 'shuD',
+        kWhatCodecCallback      = 'cdcC',
+        kWhatResume             = 'resm',
+        kWhatSetSkipOutputUntil = 'skpU',
+        kWhatDrainCallbacks     = 'drnC',
     };
 
     sp<AMessage> mNotify;
@@ -75,10 +106,72 @@ private:
 
     Vector<sp<ABuffer> > mInputBuffers;
     Vector<sp<ABuffer> > mOutputBuffers;
+    Vector<sp<BufferInfo> > mOutputBufferInfos;
+
+    // Reply/notify messages reused for every buffer of a given index, so
+    // steady-state playback doesn't allocate messages per frame. Recreated
+    // whenever mBufferGeneration changes, as stale ones may still be queued.
+    Vector<sp<AMessage> > mInputReplies;
+    Vector<sp<AMessage> > mInputNotifies;
+    Vector<sp<AMessage> > mOutputReplies;
+    Vector<sp<AMessage> > mOutputNotifies;
+
+    // Buffer availability is pushed by MediaCodec callbacks when set,
+    // otherwise polled on each activity notification.
+    bool mIsAsync;
+    bool mPaused;
+
+    // Passthrough for compressed audio offload, see configureForOffload().
+    bool mOffload;
+
+    // The codec is stopped but allocated, see initiateParking().
+    bool mParked;
+
+    // Of the last configured format, set on the caller's thread.
+    AString mPoolKey;
+
+    // When each pending video input was queued, by timestamp, for the
+    // decode latency attached to the matching output.
+    KeyedVector<int64_t, int64_t> mInputQueuedAtUs;
+
+    // See setSkipOutputUntil(), -1 when not skipping.
+    int64_t mSkipOutputUntilUs;
+    uint32_t mNumSkippedOutputs;
 
     void handleError(int32_t err);
     bool handleAnInputBuffer();
     bool handleAnOutputBuffer();
+    void onInputBufferAvailable(size_t bufferIx);
+    void onOutputBufferAvailable(
+            size_t bufferIx, size_t offset, size_t size,
+            int64_t timeUs, uint32_t flags);
+    void onOutputFormatChanged(const sp<AMessage> &format);
+    void onCodecCallback(const sp<AMessage> &msg);
+
+    // Most buffers handled per direction in one codec notification, or
+    // codec callbacks in one batch, before yielding to the looper, see
+    // persist.dash.decoder.drain.budget.
+    size_t mDrainBudget;
+
+    // Async mode: callbacks received since the last batch, all handled by
+    // a single kWhatDrainCallbacks message posted when the first arrives.
+    DashRingQueue<sp<AMessage> > mPendingCallbacks;
+    sp<AMessage> mDrainCallbacksMsg;
+    bool mDrainCallbacksPending;
+
+    // Buffers handled per looper wake-up, logged on flush and shutdown.
+    uint32_t mNumWakeups;
+    uint64_t mNumBuffersDrained;
+    size_t mMaxBuffersPerWakeup;
+
+    size_t drainCodec();
+    void onDrainCallbacks();
+    void dropPendingCallbacks();
+    void recordWakeup(size_t numBuffers);
+    void logAndResetDrainStats();
+    void allocateOutputBufferInfos();
+    void resetMessagePools();
+    void resetOutputMessagePool();
 
     void requestCodecNotification();
     bool isStaleReply(const sp<AMessage> &msg);
@@ -88,10 +181,12 @@ private:
     sp<AMessage> makeFormat(const sp<MetaData> &meta);
 
     void onConfigure(const sp<AMessage> &format);
+    void onConfigureOffload(const sp<AMessage> &format);
     void onFlush();
+    void onResume();
     void onInputBufferFilled(const sp<AMessage> &msg);
     void onRenderBuffer(const sp<AMessage> &msg);
-    void onShutdown();
+    void onShutdown(bool keepComponent, bool retired);
 
     int32_t mBufferGeneration;
     AString mComponentName;
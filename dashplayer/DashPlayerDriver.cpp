@@ -387,6 +387,45 @@ status_t DashPlayerDriver::invoke(const Parcel &request, Parcel *reply) {
           break;
        }
 
+       case KEY_DASH_PLAYBACK_RATE:
+       {
+          DPD_MSG_HIGH("calling KEY_DASH_PLAYBACK_RATE");
+          int32_t rate;
+          ret = request.readInt32(&rate);
+          if (ret != OK)
+          {
+            DPD_MSG_ERROR("Invoke: invalid playback rate");
+          }
+          else
+          {
+            ret = mPlayer->setPlaybackRate(rate / 1000.0f);
+            int32_t val = (ret == OK)? 1:0;
+            reply->setDataPosition(0);
+            reply->writeInt32(val);
+          }
+          break;
+       }
+
+       case KEY_DASH_LIVE_TARGET_LATENCY:
+       {
+          DPD_MSG_HIGH("calling KEY_DASH_LIVE_TARGET_LATENCY");
+          ret = setParameter(methodId,request);
+          int32_t val = (ret == OK)? 1:0;
+          reply->setDataPosition(0);
+          reply->writeInt32(val);
+          break;
+       }
+
+       case KEY_DASH_SEEK_MODE:
+       {
+          DPD_MSG_HIGH("calling KEY_DASH_SEEK_MODE");
+          ret = setParameter(methodId,request);
+          int32_t val = (ret == OK)? 1:0;
+          reply->setDataPosition(0);
+          reply->writeInt32(val);
+          break;
+       }
+
        case KEY_QCTIMEDTEXT_LISTENER:
        {
          DPD_MSG_HIGH("calling KEY_QCTIMEDTEXT_LISTENER");
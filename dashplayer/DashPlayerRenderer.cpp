@@ -19,6 +19,7 @@
 
 #include "DashPlayerRenderer.h"
 #include <cutils/properties.h>
+#include <media/AudioTimestamp.h>
 #include <utils/Log.h>
 
 #define DPR_MSG_ERROR(...) ALOGE(__VA_ARGS__)
@@ -31,10 +32,40 @@ namespace android {
 // static
 const int64_t DashPlayer::Renderer::kMinPositionUpdateDelayUs = 100000ll;
 
+// With vsync alignment, frames go to the codec this many vsyncs ahead of
+// the vsync they are meant for.
+static const int64_t kVsyncsEarly = 2;
+
+// Decoded audio is gathered into sink writes of about this duration.
+static const int64_t kDefaultAudioStagingUs = 20000ll;
+
+// Pull mode ring size, about 680 ms of 16 bit stereo at 48 kHz.
+static const size_t kAudioRingBytes = 256 * 1024;
+
+// In offload mode the queue is drained rarely, the position is refreshed
+// from the sink timestamps at this interval instead.
+static const int64_t kOffloadPositionPollUs = 500000ll;
+
+// Copies of offloaded access units are at least this big, so recycled ones
+// fit most AAC frames.
+static const size_t kOffloadHistoryBufferSize = 2048;
+
 DashPlayer::Renderer::Renderer(
         const sp<MediaPlayerBase::AudioSink> &sink,
         const sp<AMessage> &notify)
     : mAudioSink(sink),
+      mAudioClock(new DashAudioClock(sink)),
+      mAudioStagingUs(kDefaultAudioStagingUs),
+      mAudioRingRefillArmed(0),
+      mAudioRingReadBase(0),
+      mAudioSinkCallbacks(0),
+      mAudioOffload(false),
+      mOffloadStartMediaUs(-1ll),
+      mOffloadStartFrames(0),
+      mOffloadEOSPending(false),
+      mOffloadFinalResult(OK),
+      mAudioOffloadEOS(0),
+      mOffloadPositionPending(false),
       mNotify(notify),
       mNumFramesWritten(0),
       mDrainAudioQueuePending(false),
@@ -49,10 +80,15 @@ DashPlayer::Renderer::Renderer(
       mHasAudio(false),
       mHasVideo(false),
       mSyncQueues(false),
+      mStartSyncBeginUs(-1ll),
       mPaused(false),
       mWasPaused(false),
+      mAlignToVsync(true),
+      mLastPresentTimeUs(-1ll),
+      mLastPresentMediaTimeUs(-1ll),
       mLastPositionUpdateUs(-1ll),
       mVideoLateByUs(0ll),
+      mPlaybackRate(1.0f),
       mStats(NULL),
       mLogLevel(0) {
 
@@ -77,9 +113,42 @@ DashPlayer::Renderer::Renderer(
       if(*property_value) {
           mLogLevel = atoi(property_value);
       }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.audio.staging.ms", property_value, NULL);
+      if(*property_value && atoi(property_value) >= 0) {
+          mAudioStagingUs = atoi(property_value) * 1000ll;
+      }
+
+      // Offloading sinks are always driven through the callback.
+      bool pullMode = false;
+      property_value[0] = '\0';
+      property_get("persist.dash.audio.callback", property_value, NULL);
+      if(*property_value && atoi(property_value) != 0) {
+          pullMode = true;
+      }
+      property_value[0] = '\0';
+      property_get("persist.dash.audio.offload", property_value, NULL);
+      if(*property_value && atoi(property_value) != 0) {
+          pullMode = true;
+      }
+      if (pullMode) {
+          mAudioRing = new DashAudioRing(kAudioRingBytes);
+      }
+
+      property_value[0] = '\0';
+      property_get("persist.dash.vsync.align", property_value, NULL);
+      if(*property_value) {
+          mAlignToVsync = atoi(property_value) != 0;
+      }
 }
 
 DashPlayer::Renderer::~Renderer() {
+    if (mAudioRing != NULL && mAudioSink != NULL) {
+        // the sink's callback refers to this renderer
+        mAudioSink->stop();
+        mAudioSink->close();
+    }
     if(mStats != NULL) {
         mStats->logStatistics();
         mStats->logSyncLoss();
@@ -90,10 +159,23 @@ DashPlayer::Renderer::~Renderer() {
 void DashPlayer::Renderer::queueBuffer(
         bool audio,
         const sp<ABuffer> &buffer,
+        const sp<BufferInfo> &info,
         const sp<AMessage> &notifyConsumed) {
-    sp<AMessage> msg = new AMessage(kWhatQueueBuffer, id());
+    sp<AMessage> msg;
+    {
+        Mutex::Autolock autoLock(mQueueBufferMsgLock);
+        if (!mQueueBufferMsgs.empty()) {
+            msg = mQueueBufferMsgs.top();
+            mQueueBufferMsgs.pop();
+        }
+    }
+    if (msg == NULL) {
+        msg = new AMessage(kWhatQueueBuffer, id());
+        DashPlayerStats::countMessageAllocations(1);
+    }
     msg->setInt32("audio", static_cast<int32_t>(audio));
     msg->setBuffer("buffer", buffer);
+    msg->setObject("info", info);
     msg->setMessage("notifyConsumed", notifyConsumed);
     msg->post();
 }
@@ -101,9 +183,6 @@ void DashPlayer::Renderer::queueBuffer(
 void DashPlayer::Renderer::queueEOS(bool audio, status_t finalResult) {
     CHECK_NE(finalResult, (status_t)OK);
 
-    if(mSyncQueues)
-      syncQueuesDone();
-
     sp<AMessage> msg = new AMessage(kWhatQueueEOS, id());
     msg->setInt32("audio", static_cast<int32_t>(audio));
     msg->setInt32("finalResult", finalResult);
@@ -127,14 +206,23 @@ void DashPlayer::Renderer::flush(bool audio) {
     msg->post();
 }
 
+// The renderer may run on its own looper, so everything that touches its
+// state from the player goes through a message.
 void DashPlayer::Renderer::signalTimeDiscontinuity() {
+    (new AMessage(kWhatTimeDiscontinuity, id()))->post();
+}
+
+void DashPlayer::Renderer::onTimeDiscontinuity() {
     CHECK(mAudioQueue.empty());
     CHECK(mVideoQueue.empty());
     mAnchorTimeMediaUs = -1;
     mAnchorTimeRealUs = -1;
     mWasPaused = false;
+    mLastPresentTimeUs = -1ll;
     mSeekTimeUs = 0;
+    mOffloadStartMediaUs = -1ll;
     mSyncQueues = mHasAudio && mHasVideo;
+    mStartSyncBeginUs = mSyncQueues ? ALooper::GetNowUs() : -1ll;
     mIsFirstVideoframeReceived = false;
     mPendingPostAudioDrains = false;
     mHasAudio = false;
@@ -161,20 +249,18 @@ void DashPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             }
 
             mDrainAudioQueuePending = false;
+            recordAudioWakeup();
 
             if (onDrainAudioQueue()) {
-                uint32_t numFramesPlayed;
-                CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed),
-                         (status_t)OK);
-
-                uint32_t numFramesPendingPlayout =
-                    mNumFramesWritten - numFramesPlayed;
+                if (mAudioRing != NULL) {
+                    // the sink callback asks for more once it needs it
+                    android_atomic_release_store(1, &mAudioRingRefillArmed);
+                    break;
+                }
 
                 // This is how long the audio sink will have data to
                 // play back.
-                int64_t delayUs =
-                    (int64_t)(mAudioSink->msecsPerFrame()
-                        * (float)(numFramesPendingPlayout * 1000ll));
+                int64_t delayUs = getPendingPlayoutUs();
 
                 // Let's give it more data after about half that time
                 // has elapsed.
@@ -183,6 +269,69 @@ void DashPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatAudioRingLow:
+        {
+            postDrainAudioQueue();
+            break;
+        }
+
+        case kWhatSetAudioOffload:
+        {
+            onSetAudioOffload(msg);
+            break;
+        }
+
+        case kWhatSetPlaybackRate:
+        {
+            onSetPlaybackRate(msg);
+            break;
+        }
+
+        case kWhatAudioOffloadDrained:
+        {
+            onAudioOffloadDrained();
+            break;
+        }
+
+        case kWhatAudioOffloadEnd:
+        {
+            onAudioOffloadEnd();
+            break;
+        }
+
+        case kWhatAudioOffloadTorn:
+        {
+            if (mAudioOffload) {
+                sp<AMessage> notify = mNotify->dup();
+                notify->setInt32("what", kWhatAudioOffloadTearDown);
+                notify->post();
+            }
+            break;
+        }
+
+        case kWhatEndAudioOffload:
+        {
+            onEndAudioOffload();
+            break;
+        }
+
+        case kWhatOffloadPosition:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+            if (generation != mAudioQueueGeneration) {
+                break;
+            }
+
+            mOffloadPositionPending = false;
+            recordAudioWakeup();
+
+            updateOffloadAnchor();
+            notifyPosition();
+            postOffloadPositionPoll();
+            break;
+        }
+
         case kWhatDrainVideoQueue:
         {
             int32_t generation;
@@ -202,6 +351,7 @@ void DashPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
         case kWhatQueueBuffer:
         {
             onQueueBuffer(msg);
+            recycleQueueBufferMsg(msg);
             break;
         }
 
@@ -235,6 +385,24 @@ void DashPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatTimeDiscontinuity:
+        {
+            onTimeDiscontinuity();
+            break;
+        }
+
+        case kWhatSetMediaPresence:
+        {
+            onSetMediaPresence(msg);
+            break;
+        }
+
+        case kWhatSeekPosition:
+        {
+            onSeekPosition(msg);
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -261,66 +429,96 @@ void DashPlayer::Renderer::signalAudioSinkChanged() {
 }
 
 bool DashPlayer::Renderer::onDrainAudioQueue() {
+    if (mAudioOffload) {
+        return onDrainOffloadQueue();
+    }
+
     uint32_t numFramesPlayed;
 
     // Check if first frame is EOS, process EOS and return
     if(1 == mAudioQueue.size())
     {
-       QueueEntry *entry = &*mAudioQueue.begin();
+       QueueEntry *entry = &mAudioQueue.front();
        if (entry->mBuffer == NULL) {
         DPR_MSG_ERROR("onDrainAudioQueue process EOS");
         notifyEOS(true /* audio */, entry->mFinalResult);
 
-        mAudioQueue.erase(mAudioQueue.begin());
+        mAudioQueue.pop_front();
         entry = NULL;
         return false;
       }
     }
 
-    if (mAudioSink->getPosition(&numFramesPlayed) != OK) {
+    size_t frameSize = mAudioSink->frameSize();
+    if (mAudioRing != NULL) {
+        // Frames handed to the sink plus those still waiting in the ring,
+        // nothing the ring dropped on flush.
+        mNumFramesWritten = (uint32_t)(
+                (mAudioRing->getBytesRead() - mAudioRingReadBase
+                    + mAudioRing->getFilledBytes()) / frameSize);
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    if (mAudioClock->getFramesPlayed(
+                nowUs, mNumFramesWritten, &numFramesPlayed) != OK) {
         return false;
     }
 
-    ssize_t numFramesAvailableToWrite =
-        mAudioSink->frameCount() - (mNumFramesWritten - numFramesPlayed);
+    ssize_t numFramesAvailableToWrite = (mAudioRing != NULL)
+        ? (ssize_t)(mAudioRing->getFreeBytes() / frameSize)
+        : mAudioSink->frameCount() - (mNumFramesWritten - numFramesPlayed);
+    if (numFramesAvailableToWrite <= 0) {
+        // the clock estimate may trail the sink slightly, try again later
+        return !mAudioQueue.empty();
+    }
 
-    size_t numBytesAvailableToWrite =
-        numFramesAvailableToWrite * mAudioSink->frameSize();
+    size_t numBytesAvailableToWrite = numFramesAvailableToWrite * frameSize;
+
+    // Small decoded buffers are gathered into the staging buffer and
+    // written with one call, buffers at least that large are written
+    // straight from the queue.
+    // The ring already decouples us from the sink in pull mode.
+    size_t stagingCapacity = (mAudioRing != NULL) ? 0
+        : (size_t)(mAudioStagingUs * mAudioSink->getSampleRate() / 1000000ll) * frameSize;
+    if (stagingCapacity > 0
+            && (mAudioStaging == NULL || mAudioStaging->capacity() != stagingCapacity)) {
+        mAudioStaging = new ABuffer(stagingCapacity);
+    }
+    size_t staged = 0;
 
     while (numBytesAvailableToWrite > 0 && !mAudioQueue.empty()) {
-        QueueEntry *entry = &*mAudioQueue.begin();
+        QueueEntry *entry = &mAudioQueue.front();
 
         if (entry->mBuffer == NULL) {
             // EOS
 
+            writeAudioStaging(&staged);
+            notifyAudioConsumed();
+
             notifyEOS(true /* audio */, entry->mFinalResult);
 
-            mAudioQueue.erase(mAudioQueue.begin());
+            mAudioQueue.pop_front();
             entry = NULL;
             return false;
         }
 
         if (entry->mOffset == 0) {
-            int64_t mediaTimeUs;
-            CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+            int64_t mediaTimeUs = entry->mTimeUs;
 
             DPR_MSG_HIGH("rendering audio at media time %.2f secs", (double)mediaTimeUs / 1E6);
 
             mAnchorTimeMediaUs = mediaTimeUs;
 
-            uint32_t numFramesPlayed;
-            CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed), (status_t)OK);
-
+            // numFramesPlayed is the clock's estimate for nowUs, only the
+            // frames written or staged since then are added.
             uint32_t numFramesPendingPlayout =
-                mNumFramesWritten - numFramesPlayed;
+                mNumFramesWritten + staged / frameSize - numFramesPlayed;
 
             int64_t realTimeOffsetUs =
-                (int64_t)(((float)mAudioSink->latency() / 2
-                    + (float)numFramesPendingPlayout
-                        * mAudioSink->msecsPerFrame()) * 1000ll);
+                (int64_t)mAudioSink->latency() * 1000ll / 2
+                    + mAudioClock->getDurationUs(numFramesPendingPlayout);
 
-            mAnchorTimeRealUs =
-                ALooper::GetNowUs() + realTimeOffsetUs;
+            mAnchorTimeRealUs = nowUs + realTimeOffsetUs;
         }
 
         size_t copy = entry->mBuffer->size() - entry->mOffset;
@@ -328,28 +526,512 @@ bool DashPlayer::Renderer::onDrainAudioQueue() {
             copy = numBytesAvailableToWrite;
         }
 
-        CHECK_EQ(mAudioSink->write(
-                    entry->mBuffer->data() + entry->mOffset, copy),
-                 (ssize_t)copy);
+        if (staged == 0 && copy >= stagingCapacity) {
+            writeToAudioSink(entry->mBuffer->data() + entry->mOffset, copy);
+        } else {
+            if (copy > stagingCapacity - staged) {
+                copy = stagingCapacity - staged;
+            }
+            memcpy(mAudioStaging->data() + staged,
+                   entry->mBuffer->data() + entry->mOffset, copy);
+            staged += copy;
+        }
 
         entry->mOffset += copy;
         if (entry->mOffset == entry->mBuffer->size()) {
-            entry->mNotifyConsumed->post();
-            mAudioQueue.erase(mAudioQueue.begin());
+            mAudioConsumed.push_back(entry->mNotifyConsumed);
+            mAudioQueue.pop_front();
 
             entry = NULL;
         }
 
         numBytesAvailableToWrite -= copy;
-        size_t copiedFrames = copy / mAudioSink->frameSize();
-        mNumFramesWritten += (uint32_t)copiedFrames;
+
+        if (staged == stagingCapacity) {
+            writeAudioStaging(&staged);
+        }
     }
 
+    writeAudioStaging(&staged);
+
+    // decoder buffers go back together, once their data is in the sink
+    notifyAudioConsumed();
+
     notifyPosition();
 
     return !mAudioQueue.empty();
 }
 
+bool DashPlayer::Renderer::onDrainOffloadQueue() {
+    while (!mAudioQueue.empty()) {
+        QueueEntry *entry = &mAudioQueue.front();
+
+        if (entry->mBuffer == NULL) {
+            // EOS
+            notifyAudioConsumed();
+
+            status_t finalResult = entry->mFinalResult;
+            mAudioQueue.pop_front();
+            entry = NULL;
+
+            if (finalResult != ERROR_END_OF_STREAM) {
+                notifyEOS(true /* audio */, finalResult);
+                return false;
+            }
+
+            // The sink still has a lot to play, the callback tells us
+            // once the ring ran dry and the sink can be drained.
+            mOffloadEOSPending = true;
+            mOffloadFinalResult = finalResult;
+            android_atomic_release_store(1, &mAudioOffloadEOS);
+            return false;
+        }
+
+        if (mOffloadStartMediaUs < 0) {
+            mOffloadStartMediaUs = entry->mTimeUs;
+            mOffloadStartFrames = 0;
+            mAudioSink->getPosition(&mOffloadStartFrames);
+
+            DPR_MSG_HIGH("offloading audio from media time %.2f secs",
+                    (double)mOffloadStartMediaUs / 1E6);
+
+            // until the sink reports a timestamp
+            mAnchorTimeMediaUs = mOffloadStartMediaUs;
+            mAnchorTimeRealUs = ALooper::GetNowUs()
+                + (int64_t)mAudioSink->latency() * 1000ll;
+        }
+
+        size_t copy = entry->mBuffer->size() - entry->mOffset;
+        size_t freeBytes = mAudioRing->getFreeBytes();
+        if (copy > freeBytes) {
+            copy = freeBytes;
+        }
+        if (copy == 0) {
+            break;
+        }
+
+        CHECK_EQ(mAudioRing->write(
+                    entry->mBuffer->data() + entry->mOffset, copy), copy);
+
+        entry->mOffset += copy;
+        if (entry->mOffset == entry->mBuffer->size()) {
+            recordOffloadHistory(*entry);
+            mAudioConsumed.push_back(entry->mNotifyConsumed);
+            mAudioQueue.pop_front();
+
+            entry = NULL;
+        }
+    }
+
+    notifyAudioConsumed();
+
+    updateOffloadAnchor();
+    notifyPosition();
+    postOffloadPositionPoll();
+
+    return !mAudioQueue.empty();
+}
+
+void DashPlayer::Renderer::updateOffloadAnchor() {
+    if (mOffloadStartMediaUs < 0) {
+        return;
+    }
+
+    uint32_t sampleRate = mAudioSink->getSampleRate();
+    if (sampleRate == 0) {
+        return;
+    }
+
+    uint32_t position;
+    int64_t realTimeUs;
+    AudioTimestamp ts;
+    if (mAudioSink->getTimestamp(ts) == OK) {
+        position = ts.mPosition;
+        realTimeUs = ts.mTime.tv_sec * 1000000ll + ts.mTime.tv_nsec / 1000;
+    } else if (mAudioSink->getPosition(&position) == OK) {
+        realTimeUs = ALooper::GetNowUs();
+    } else {
+        return;
+    }
+
+    int32_t numFramesPlayed = (int32_t)(position - mOffloadStartFrames);
+    if (numFramesPlayed < 0) {
+        // the sink restarted its count after we sampled it
+        mOffloadStartFrames = position;
+        numFramesPlayed = 0;
+    }
+
+    mAnchorTimeMediaUs =
+        mOffloadStartMediaUs + (int64_t)numFramesPlayed * 1000000ll / sampleRate;
+    mAnchorTimeRealUs = realTimeUs;
+
+    trimOffloadHistory();
+}
+
+// The decoder buffer goes back once written, so the access unit is copied.
+void DashPlayer::Renderer::recordOffloadHistory(const QueueEntry &entry) {
+    size_t size = entry.mBuffer->size();
+
+    sp<ABuffer> copy;
+    while (copy == NULL && !mOffloadHistoryFree.empty()) {
+        if (mOffloadHistoryFree.front()->capacity() >= size) {
+            copy = mOffloadHistoryFree.front();
+        }
+        mOffloadHistoryFree.pop_front();
+    }
+    if (copy == NULL) {
+        copy = new ABuffer(size > kOffloadHistoryBufferSize ? size : kOffloadHistoryBufferSize);
+    }
+
+    memcpy(copy->data(), entry.mBuffer->data(), size);
+    copy->setRange(0, size);
+    copy->meta()->setInt64("timeUs", entry.mTimeUs);
+
+    QueueEntry historyEntry;
+    historyEntry.mBuffer = copy;
+    historyEntry.mOffset = 0;
+    historyEntry.mFinalResult = OK;
+    historyEntry.mTimeUs = entry.mTimeUs;
+    mOffloadHistory.push_back(historyEntry);
+}
+
+// Keeps the access unit the sink is playing and everything after it.
+void DashPlayer::Renderer::trimOffloadHistory() {
+    while (mOffloadHistory.size() > 1
+            && mOffloadHistory[1].mTimeUs <= mAnchorTimeMediaUs) {
+        mOffloadHistoryFree.push_back(mOffloadHistory.front().mBuffer);
+        mOffloadHistory.pop_front();
+    }
+}
+
+void DashPlayer::Renderer::clearOffloadHistory() {
+    while (!mOffloadHistory.empty()) {
+        mOffloadHistoryFree.push_back(mOffloadHistory.front().mBuffer);
+        mOffloadHistory.pop_front();
+    }
+}
+
+void DashPlayer::Renderer::endAudioOffload() {
+    (new AMessage(kWhatEndAudioOffload, id()))->post();
+}
+
+// Unlike a flush, nothing the sink has not played is lost: it goes back
+// to the player, which decodes it from where the sink stopped.
+void DashPlayer::Renderer::onEndAudioOffload() {
+    sp<AudioReplay> replay = new AudioReplay;
+    int64_t resumeUs = -1ll;
+
+    if (mAudioOffload) {
+        updateOffloadAnchor();
+        if (mOffloadStartMediaUs >= 0) {
+            resumeUs = mAnchorTimeMediaUs;
+        }
+
+        mAudioSink->pause();
+        mAudioSink->flush();
+
+        // written to the ring, from the access unit being played on
+        while (!mOffloadHistory.empty()) {
+            replay->mAccessUnits.push_back(mOffloadHistory.front().mBuffer);
+            mOffloadHistory.pop_front();
+        }
+        while (!mOffloadHistoryFree.empty()) {
+            mOffloadHistoryFree.pop_front();
+        }
+
+        // not written yet, or only partly
+        for (size_t i = 0; i < mAudioQueue.size(); ++i) {
+            const QueueEntry &entry = mAudioQueue[i];
+            if (entry.mBuffer == NULL) {
+                // EOS, the source reports it again
+                continue;
+            }
+            sp<ABuffer> copy = new ABuffer(entry.mBuffer->size());
+            memcpy(copy->data(), entry.mBuffer->data(), entry.mBuffer->size());
+            copy->meta()->setInt64("timeUs", entry.mTimeUs);
+            replay->mAccessUnits.push_back(copy);
+        }
+        flushQueue(&mAudioQueue);
+        notifyAudioConsumed();
+
+        if (mAudioRing != NULL) {
+            mAudioRing->flush();
+            android_atomic_release_store(0, &mAudioRingRefillArmed);
+        }
+
+        DPR_MSG_HIGH("audio offload ended at %.2f secs, %zu access units to decode",
+                (double)resumeUs / 1E6, replay->mAccessUnits.size());
+
+        // video keeps running on the last anchor until decoded audio
+        // re-anchors the clock
+        mAudioOffload = false;
+        mOffloadStartMediaUs = -1ll;
+        mOffloadEOSPending = false;
+        android_atomic_release_store(0, &mAudioOffloadEOS);
+        mOffloadPositionPending = false;
+        mDrainAudioQueuePending = false;
+        ++mAudioQueueGeneration;
+
+        if(mStats != NULL) {
+            mStats->setAudioOffload(false);
+        }
+    }
+
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatAudioOffloadEnded);
+    notify->setInt64("resumeUs", resumeUs);
+    notify->setObject("replay", replay);
+    notify->post();
+}
+
+void DashPlayer::Renderer::postOffloadPositionPoll() {
+    if (!mAudioOffload || mOffloadPositionPending || mPaused
+            || mOffloadStartMediaUs < 0) {
+        return;
+    }
+
+    mOffloadPositionPending = true;
+    sp<AMessage> msg = new AMessage(kWhatOffloadPosition, id());
+    msg->setInt32("generation", mAudioQueueGeneration);
+    msg->post(kOffloadPositionPollUs);
+}
+
+void DashPlayer::Renderer::setAudioOffload(bool offload) {
+    sp<AMessage> msg = new AMessage(kWhatSetAudioOffload, id());
+    msg->setInt32("offload", static_cast<int32_t>(offload));
+    msg->post();
+}
+
+void DashPlayer::Renderer::onSetAudioOffload(const sp<AMessage> &msg) {
+    int32_t offload;
+    CHECK(msg->findInt32("offload", &offload));
+    CHECK(!offload || mAudioRing != NULL);
+
+    DPR_MSG_HIGH("audio offload %s", offload ? "on" : "off");
+
+    mAudioOffload = offload;
+    mOffloadStartMediaUs = -1ll;
+    mOffloadEOSPending = false;
+    android_atomic_release_store(0, &mAudioOffloadEOS);
+    clearOffloadHistory();
+    while (!offload && !mOffloadHistoryFree.empty()) {
+        mOffloadHistoryFree.pop_front();
+    }
+
+    if(mStats != NULL) {
+        mStats->setAudioOffload(offload);
+    }
+}
+
+void DashPlayer::Renderer::setPlaybackRate(float rate) {
+    sp<AMessage> msg = new AMessage(kWhatSetPlaybackRate, id());
+    msg->setFloat("rate", rate);
+    msg->post();
+}
+
+void DashPlayer::Renderer::onSetPlaybackRate(const sp<AMessage> &msg) {
+    float rate;
+    CHECK(msg->findFloat("rate", &rate));
+
+    DPR_MSG_HIGH("playback rate %.3f -> %.3f", mPlaybackRate, rate);
+
+    // Re-anchor at the current position so the clock does not jump.
+    if (mAnchorTimeMediaUs >= 0 && mAnchorTimeRealUs >= 0 && !mPaused) {
+        int64_t nowUs = ALooper::GetNowUs();
+        mAnchorTimeMediaUs = getMediaTimeUs(nowUs);
+        mAnchorTimeRealUs = nowUs;
+    }
+    mPlaybackRate = rate;
+
+    if (mTimeStretcher != NULL) {
+        mTimeStretcher->setRate(rate);
+    }
+
+    if (mAudioOffload && rate != 1.0f) {
+        // compressed audio cannot be stretched, fall back to decoding
+        sp<AMessage> notify = mNotify->dup();
+        notify->setInt32("what", kWhatAudioOffloadTearDown);
+        notify->post();
+    }
+
+    if (!mVideoQueue.empty() && mDrainVideoQueuePending) {
+        // reschedule the next frame on the new clock
+        mDrainVideoQueuePending = false;
+        ++mVideoQueueGeneration;
+        postDrainVideoQueue();
+    }
+}
+
+// Replaces the entry's decoded PCM with its time-stretched version, which
+// starts at the returned media time. False while the stretcher is still
+// buffering, the entry then carries nothing to play.
+bool DashPlayer::Renderer::stretchAudioEntry(QueueEntry *entry) {
+    uint32_t sampleRate = mAudioSink->getSampleRate();
+    ssize_t numChannels = mAudioSink->channelCount();
+    size_t frameSize = mAudioSink->frameSize();
+    if (sampleRate == 0 || numChannels <= 0
+            || frameSize != numChannels * sizeof(int16_t)) {
+        return true;
+    }
+
+    if (mTimeStretcher == NULL
+            || mTimeStretcher->getSampleRate() != sampleRate
+            || mTimeStretcher->getChannelCount() != (size_t)numChannels) {
+        mTimeStretcher = new DashTimeStretcher(sampleRate, numChannels);
+    }
+    mTimeStretcher->setRate(mPlaybackRate);
+
+    int64_t timeUs;
+    sp<ABuffer> stretched = mTimeStretcher->process(
+            (const int16_t *)entry->mBuffer->data(),
+            entry->mBuffer->size() / frameSize, entry->mTimeUs, &timeUs);
+    if (stretched == NULL) {
+        return false;
+    }
+
+    entry->mBuffer = stretched;
+    entry->mTimeUs = timeUs;
+    return true;
+}
+
+// Output frames per second of media time in the audio queue.
+uint32_t DashPlayer::Renderer::getAudioMediaSampleRate() const {
+    uint32_t sampleRate = mAudioSink->getSampleRate();
+    if (mTimeStretcher != NULL) {
+        sampleRate = (uint32_t)(sampleRate / mPlaybackRate);
+    }
+    return sampleRate;
+}
+
+int64_t DashPlayer::Renderer::getRealTimeUs(int64_t mediaTimeUs) const {
+    return mAnchorTimeRealUs
+        + (int64_t)((mediaTimeUs - mAnchorTimeMediaUs) / mPlaybackRate);
+}
+
+int64_t DashPlayer::Renderer::getMediaTimeUs(int64_t realTimeUs) const {
+    return mAnchorTimeMediaUs
+        + (int64_t)((realTimeUs - mAnchorTimeRealUs) * mPlaybackRate);
+}
+
+void DashPlayer::Renderer::onAudioOffloadDrained() {
+    if (!mOffloadEOSPending) {
+        return;
+    }
+
+    // an offloaded track plays out what it holds and then reports
+    // CB_EVENT_STREAM_END
+    mAudioSink->stop();
+}
+
+void DashPlayer::Renderer::onAudioOffloadEnd() {
+    if (!mOffloadEOSPending) {
+        return;
+    }
+
+    mOffloadEOSPending = false;
+
+    updateOffloadAnchor();
+    notifyPosition(true);
+    mOffloadStartMediaUs = -1ll;
+    clearOffloadHistory();
+
+    notifyEOS(true /* audio */, mOffloadFinalResult);
+}
+
+void DashPlayer::Renderer::recordAudioWakeup() {
+    if (mStats != NULL) {
+        // sink callbacks are counted on their own thread, folded in here
+        mStats->recordAudioWakeups(
+                1 + android_atomic_and(0, &mAudioSinkCallbacks));
+    }
+}
+
+void DashPlayer::Renderer::writeAudioStaging(size_t *staged) {
+    if (*staged == 0) {
+        return;
+    }
+
+    writeToAudioSink(mAudioStaging->data(), *staged);
+    *staged = 0;
+}
+
+void DashPlayer::Renderer::writeToAudioSink(const void *data, size_t size) {
+    if (mAudioRing != NULL) {
+        CHECK_EQ(mAudioRing->write(data, size), size);
+    } else {
+        CHECK_EQ(mAudioSink->write(data, size), (ssize_t)size);
+    }
+    mNumFramesWritten += (uint32_t)(size / mAudioSink->frameSize());
+}
+
+MediaPlayerBase::AudioSink::AudioCallback
+DashPlayer::Renderer::getAudioSinkCallback() const {
+    return (mAudioRing != NULL) ? &AudioSinkCallback : NULL;
+}
+
+// static
+size_t DashPlayer::Renderer::AudioSinkCallback(
+        MediaPlayerBase::AudioSink * /* audioSink */,
+        void *buffer, size_t size, void *cookie,
+        MediaPlayerBase::AudioSink::cb_event_t event) {
+    Renderer *me = static_cast<Renderer *>(cookie);
+
+    switch (event) {
+        case MediaPlayerBase::AudioSink::CB_EVENT_FILL_BUFFER:
+            return me->fillAudioSinkBuffer(buffer, size);
+
+        case MediaPlayerBase::AudioSink::CB_EVENT_STREAM_END:
+            (new AMessage(kWhatAudioOffloadEnd, me->id()))->post();
+            break;
+
+        case MediaPlayerBase::AudioSink::CB_EVENT_TEAR_DOWN:
+            (new AMessage(kWhatAudioOffloadTorn, me->id()))->post();
+            break;
+
+        default:
+            break;
+    }
+    return 0;
+}
+
+// Runs on the AudioSink callback thread.
+size_t DashPlayer::Renderer::fillAudioSinkBuffer(void *buffer, size_t size) {
+    android_atomic_inc(&mAudioSinkCallbacks);
+
+    // read the flag first, everything written before it is then visible
+    int32_t eos = android_atomic_acquire_load(&mAudioOffloadEOS);
+
+    size_t copied = mAudioRing->read(buffer, size);
+
+    if (eos && copied == 0
+            && android_atomic_cmpxchg(1, 0, &mAudioOffloadEOS) == 0) {
+        (new AMessage(kWhatAudioOffloadDrained, id()))->post();
+    }
+
+    if (mAudioRing->getFilledBytes() < mAudioRing->getCapacity() / 2
+            && android_atomic_cmpxchg(1, 0, &mAudioRingRefillArmed) == 0) {
+        (new AMessage(kWhatAudioRingLow, id()))->post();
+    }
+
+    return copied;
+}
+
+void DashPlayer::Renderer::notifyAudioConsumed() {
+    while (!mAudioConsumed.empty()) {
+        mAudioConsumed.front()->post();
+        mAudioConsumed.pop_front();
+    }
+}
+
+int64_t DashPlayer::Renderer::getPendingPlayoutUs() {
+    uint32_t numFramesPlayed;
+    if (mAudioClock->getFramesPlayed(
+                ALooper::GetNowUs(), mNumFramesWritten, &numFramesPlayed) != OK) {
+        return 0;
+    }
+    return mAudioClock->getDurationUs(mNumFramesWritten - numFramesPlayed);
+}
+
 void DashPlayer::Renderer::postDrainVideoQueue() {
     if (mDrainVideoQueuePending || mSyncQueues || mPaused) {
         return;
@@ -359,7 +1041,7 @@ void DashPlayer::Renderer::postDrainVideoQueue() {
         return;
     }
 
-    QueueEntry &entry = *mVideoQueue.begin();
+    QueueEntry &entry = mVideoQueue.front();
 
     sp<AMessage> msg = new AMessage(kWhatDrainVideoQueue, id());
     msg->setInt32("generation", mVideoQueueGeneration);
@@ -370,8 +1052,7 @@ void DashPlayer::Renderer::postDrainVideoQueue() {
         // EOS doesn't carry a timestamp.
         delayUs = 0;
     } else {
-        int64_t mediaTimeUs;
-        CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+        int64_t mediaTimeUs = entry.mTimeUs;
 
         if (mAnchorTimeMediaUs < 0) {
             delayUs = 0;
@@ -388,8 +1069,13 @@ void DashPlayer::Renderer::postDrainVideoQueue() {
                mWasPaused = false;
             }
 
-            int64_t realTimeUs =
-                (mediaTimeUs - mAnchorTimeMediaUs) + mAnchorTimeRealUs;
+            int64_t realTimeUs = getRealTimeUs(mediaTimeUs);
+
+            int64_t vsyncPeriodUs = getVsyncPeriodUs();
+            if (vsyncPeriodUs > 0) {
+                realTimeUs = mVideoScheduler->schedule(realTimeUs * 1000ll) / 1000ll;
+                realTimeUs -= kVsyncsEarly * vsyncPeriodUs;
+            }
 
             delayUs = realTimeUs - ALooper::GetNowUs();
         }
@@ -405,7 +1091,7 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
         return;
     }
 
-    QueueEntry *entry = &*mVideoQueue.begin();
+    QueueEntry *entry = &mVideoQueue.front();
 
     if (entry->mBuffer == NULL) {
         // EOS
@@ -414,7 +1100,7 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
 
         notifyEOS(false /* audio */, entry->mFinalResult);
 
-        mVideoQueue.erase(mVideoQueue.begin());
+        mVideoQueue.pop_front();
         entry = NULL;
 
         mVideoLateByUs = 0ll;
@@ -422,15 +1108,18 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
         return;
     }
 
-    int64_t mediaTimeUs;
-    CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
+    int64_t mediaTimeUs = entry->mTimeUs;
 
-    int64_t realTimeUs = mediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
+    int64_t realTimeUs = getRealTimeUs(mediaTimeUs);
     int64_t nowUs = ALooper::GetNowUs();
     mVideoLateByUs = nowUs - realTimeUs;
 
     bool tooLate = (mVideoLateByUs > mAVSyncDelayWindowUs);
 
+    if (mDropController != NULL) {
+        mDropController->onFrameRendered(mVideoLateByUs);
+    }
+
     if (tooLate && !mHasAudio)
     {
         DPR_MSG_HIGH("video only - resetting anchortime");
@@ -439,6 +1128,21 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
         tooLate = false;
     }
 
+    // The display latches the frame at the first vsync after its
+    // timestamp, aim half a period before the intended edge.
+    int64_t presentTimeUs = nowUs;
+    int64_t vsyncPeriodUs = getVsyncPeriodUs();
+    if (!tooLate && vsyncPeriodUs > 0) {
+        int64_t targetTimeUs = getRealTimeUs(mediaTimeUs);
+        int64_t vsyncTimeUs =
+            mVideoScheduler->schedule(targetTimeUs * 1000ll) / 1000ll;
+        if (vsyncTimeUs > nowUs) {
+            presentTimeUs = vsyncTimeUs;
+            entry->mNotifyConsumed->setInt64(
+                    "timestampNs", (vsyncTimeUs - vsyncPeriodUs / 2) * 1000ll);
+        }
+    }
+
     if (tooLate) {
         DPR_MSG_HIGH("video late by %lld us (%.2f secs)",
              mVideoLateByUs, (double)mVideoLateByUs / 1E6);
@@ -447,21 +1151,44 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
         }
     } else {
         DPR_MSG_HIGH("rendering video at media time %.2f secs", (double)mediaTimeUs / 1E6);
+        if (mStartSyncBeginUs >= 0) {
+            DPR_MSG_HIGH("first A/V frame %lld us after the discontinuity",
+                    nowUs - mStartSyncBeginUs);
+            if (mStats != NULL) {
+                mStats->recordStartSyncLatency(nowUs - mStartSyncBeginUs);
+            }
+            mStartSyncBeginUs = -1ll;
+        }
         if(mStats != NULL) {
             mStats->recordOnTime(realTimeUs,nowUs,mVideoLateByUs);
+            mStats->markSeekStage(DashPlayerStats::kSeekStageRender);
             mStats->incrementTotalRenderingFrames();
             mStats->logFps();
+            if (mLastPresentTimeUs >= 0) {
+                mStats->recordPacingJitter(
+                        (presentTimeUs - mLastPresentTimeUs)
+                            - (mediaTimeUs - mLastPresentMediaTimeUs));
+            }
         }
+        mLastPresentTimeUs = presentTimeUs;
+        mLastPresentMediaTimeUs = mediaTimeUs;
     }
 
     entry->mNotifyConsumed->setInt32("render", !tooLate);
     entry->mNotifyConsumed->post();
-    mVideoQueue.erase(mVideoQueue.begin());
+    mVideoQueue.pop_front();
     entry = NULL;
 
     notifyPosition();
 }
 
+int64_t DashPlayer::Renderer::getVsyncPeriodUs() const {
+    if (mVideoScheduler == NULL) {
+        return 0;
+    }
+    return mVideoScheduler->getVsyncPeriod() / 1000ll;
+}
+
 void DashPlayer::Renderer::notifyEOS(bool audio, status_t finalResult) {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatEOS);
@@ -490,20 +1217,30 @@ void DashPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
     sp<AMessage> notifyConsumed;
     CHECK(msg->findMessage("notifyConsumed", &notifyConsumed));
 
+    sp<BufferInfo> info = BufferInfo::Find(msg);
+    CHECK(info != NULL);
+
     QueueEntry entry;
     entry.mBuffer = buffer;
     entry.mNotifyConsumed = notifyConsumed;
     entry.mOffset = 0;
     entry.mFinalResult = OK;
+    entry.mTimeUs = info->mTimeUs;
+
+    if (audio && !mAudioOffload
+            && (mPlaybackRate != 1.0f || mTimeStretcher != NULL)
+            && !stretchAudioEntry(&entry)) {
+        // all of it is held by the stretcher for now
+        notifyConsumed->post();
+        return;
+    }
 
     if (audio) {
         mAudioQueue.push_back(entry);
-        int64_t audioTimeUs;
-        (buffer->meta())->findInt64("timeUs", &audioTimeUs);
+        int64_t audioTimeUs = entry.mTimeUs;
         if ((mHasVideo && mIsFirstVideoframeReceived)
             || !mHasVideo){
         postDrainAudioQueue();
-            return;
         }
         else
         {
@@ -511,9 +1248,16 @@ void DashPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
           DPR_MSG_HIGH("Not rendering Audio Sample with TS: %lld  as Video frame is not decoded", audioTimeUs);
         }
     } else {
+        if (mAlignToVsync && mVideoScheduler == NULL) {
+            mVideoScheduler = new DashVideoFrameScheduler;
+            if (!mVideoScheduler->init()) {
+                mAlignToVsync = false;
+                mVideoScheduler.clear();
+            }
+        }
+
         mVideoQueue.push_back(entry);
-        int64_t videoTimeUs;
-        (buffer->meta())->findInt64("timeUs", &videoTimeUs);
+        int64_t videoTimeUs = entry.mTimeUs;
         if (!mIsFirstVideoframeReceived) {
             mIsFirstVideoframeReceived = true;
             DPR_MSG_HIGH("Received first video Sample with TS: %lld", videoTimeUs);
@@ -525,42 +1269,108 @@ void DashPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
         postDrainVideoQueue();
     }
 
+    syncQueues();
+}
+
+// Aligns the start of audio to the first video frame in one pass: audio
+// ending before it goes straight back to the decoder and the buffer
+// straddling it is trimmed to the exact PCM frame. Both queues are then
+// released together. Until audio reaching the video start has arrived
+// neither queue drains.
+void DashPlayer::Renderer::syncQueues() {
     if (!mSyncQueues || mAudioQueue.empty() || mVideoQueue.empty()) {
         return;
     }
 
-    sp<ABuffer> firstAudioBuffer = (*mAudioQueue.begin()).mBuffer;
-    sp<ABuffer> firstVideoBuffer = (*mVideoQueue.begin()).mBuffer;
-
-    if (firstAudioBuffer == NULL || firstVideoBuffer == NULL) {
-        // EOS signalled on either queue.
+    const QueueEntry &firstVideoEntry = mVideoQueue.front();
+    if (firstVideoEntry.mBuffer == NULL) {
+        // EOS signalled on the video queue.
         syncQueuesDone();
         return;
     }
 
-    int64_t firstAudioTimeUs;
-    int64_t firstVideoTimeUs;
-    CHECK(firstAudioBuffer->meta()
-            ->findInt64("timeUs", &firstAudioTimeUs));
-    CHECK(firstVideoBuffer->meta()
-            ->findInt64("timeUs", &firstVideoTimeUs));
+    int64_t startUs = firstVideoEntry.mTimeUs;
+
+    // Compressed buffers have no known duration, an offloaded buffer is
+    // only dropped once the next one starts at or before the video.
+    size_t frameSize = mAudioOffload ? 0 : mAudioSink->frameSize();
+    uint32_t sampleRate = mAudioOffload ? 0 : getAudioMediaSampleRate();
+
+    size_t numDropped = 0;
+    while (!mAudioQueue.empty()) {
+        QueueEntry *entry = &mAudioQueue.front();
+        if (entry->mBuffer == NULL) {
+            // EOS signalled on the audio queue.
+            break;
+        }
+
+        if (entry->mTimeUs >= startUs) {
+            break;
+        }
 
-    int64_t diff = firstVideoTimeUs - firstAudioTimeUs;
+        int64_t endUs;
+        if (frameSize > 0 && sampleRate > 0) {
+            endUs = entry->mTimeUs
+                + (int64_t)(entry->mBuffer->size() / frameSize) * 1000000ll / sampleRate;
+        } else if (mAudioQueue.size() > 1) {
+            const QueueEntry &next = mAudioQueue[1];
+            if (next.mBuffer == NULL) {
+                // the last buffer before EOS is kept
+                break;
+            }
+            endUs = next.mTimeUs;
+        } else {
+            // the next buffer tells whether this one can go
+            return;
+        }
 
-    DPR_MSG_LOW("queueDiff = %.2f secs", (double)diff / 1E6);
+        if (endUs > startUs) {
+            trimAudioEntry(entry, startUs);
+            break;
+        }
 
-    if (diff > 100000ll) {
-        // Audio data starts More than 0.1 secs before video.
-        // Drop some audio.
+        entry->mNotifyConsumed->post();
+        mAudioQueue.pop_front();
+        entry = NULL;
+        ++numDropped;
+    }
+
+    if (numDropped > 0) {
+        DPR_MSG_LOW("start sync dropped %zu audio buffers before %lld us",
+                numDropped, startUs);
+    }
 
-        (*mAudioQueue.begin()).mNotifyConsumed->post();
-        mAudioQueue.erase(mAudioQueue.begin());
+    if (mAudioQueue.empty()) {
+        // all audio so far precedes the video, wait for more
         return;
     }
 
     syncQueuesDone();
 }
 
+// Skips the PCM frames of the entry that precede startUs.
+void DashPlayer::Renderer::trimAudioEntry(QueueEntry *entry, int64_t startUs) {
+    if (mAudioOffload || entry->mOffset != 0) {
+        return;
+    }
+
+    int64_t timeUs = entry->mTimeUs;
+    if (TrimPCMBuffer(entry->mBuffer, &entry->mTimeUs, startUs,
+                getAudioMediaSampleRate(), mAudioSink->frameSize())
+            && entry->mTimeUs != timeUs) {
+        DPR_MSG_LOW("start sync trimmed audio from %lld us to %lld us",
+                timeUs, entry->mTimeUs);
+    }
+}
+
+void DashPlayer::Renderer::recycleQueueBufferMsg(const sp<AMessage> &msg) {
+    // Drop the buffer references now, the message may sit in the pool.
+    msg->clear();
+
+    Mutex::Autolock autoLock(mQueueBufferMsgLock);
+    mQueueBufferMsgs.push(msg);
+}
+
 void DashPlayer::Renderer::syncQueuesDone() {
     if (!mSyncQueues) {
         return;
@@ -578,6 +1388,9 @@ void DashPlayer::Renderer::syncQueuesDone() {
 }
 
 void DashPlayer::Renderer::onQueueEOS(const sp<AMessage> &msg) {
+    if(mSyncQueues)
+      syncQueuesDone();
+
     int32_t audio;
     CHECK(msg->findInt32("audio", &audio));
 
@@ -591,6 +1404,7 @@ void DashPlayer::Renderer::onQueueEOS(const sp<AMessage> &msg) {
     QueueEntry entry;
     entry.mOffset = 0;
     entry.mFinalResult = finalResult;
+    entry.mTimeUs = -1;
 
     if (audio) {
         mAudioQueue.push_back(entry);
@@ -617,6 +1431,29 @@ void DashPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
 
     if (audio) {
         flushQueue(&mAudioQueue);
+        mAudioClock->reset();
+        if (mPlaybackRate == 1.0f) {
+            mTimeStretcher.clear();
+        } else if (mTimeStretcher != NULL) {
+            mTimeStretcher->reset();
+        }
+        if (mAudioRing != NULL) {
+            mAudioRing->flush();
+            android_atomic_release_store(0, &mAudioRingRefillArmed);
+        }
+        if (mAudioOffload) {
+            // the sink holds seconds of compressed audio, drop that too
+            mAudioSink->pause();
+            mAudioSink->flush();
+            if (!mPaused) {
+                mAudioSink->start();
+            }
+            mOffloadStartMediaUs = -1ll;
+            mOffloadEOSPending = false;
+            android_atomic_release_store(0, &mAudioOffloadEOS);
+            mOffloadPositionPending = false;
+            clearOffloadHistory();
+        }
 
         Mutex::Autolock autoLock(mFlushLock);
         mFlushingAudio = false;
@@ -631,6 +1468,7 @@ void DashPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
 
         mDrainVideoQueuePending = false;
         ++mVideoQueueGeneration;
+        mLastPresentTimeUs = -1ll;
         if(mStats != NULL) {
             mStats->setVeryFirstFrame(true);
         }
@@ -639,15 +1477,15 @@ void DashPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
     notifyFlushComplete(audio);
 }
 
-void DashPlayer::Renderer::flushQueue(List<QueueEntry> *queue) {
+void DashPlayer::Renderer::flushQueue(DashRingQueue<QueueEntry> *queue) {
     while (!queue->empty()) {
-        QueueEntry *entry = &*queue->begin();
+        QueueEntry *entry = &queue->front();
 
         if (entry->mBuffer != NULL) {
             entry->mNotifyConsumed->post();
         }
 
-        queue->erase(queue->begin());
+        queue->pop_front();
         entry = NULL;
     }
 }
@@ -686,6 +1524,13 @@ bool DashPlayer::Renderer::dropBufferWhileFlushing(
 
 void DashPlayer::Renderer::onAudioSinkChanged() {
     CHECK(!mDrainAudioQueuePending);
+    mAudioClock->reset();
+    // rebuilt for the new format by the next buffer if still needed
+    mTimeStretcher.clear();
+    if (mAudioRing != NULL) {
+        mAudioRing->flush();
+        mAudioRingReadBase = mAudioRing->getBytesRead();
+    }
     mNumFramesWritten = 0;
     uint32_t written;
     if (mAudioSink->getFramesWritten(&written) == OK) {
@@ -706,7 +1551,7 @@ void DashPlayer::Renderer::notifyPosition(bool isEOS) {
     }
     mLastPositionUpdateUs = nowUs;
 
-    int64_t positionUs = (mSeekTimeUs != 0) ? mSeekTimeUs : ((nowUs - mAnchorTimeRealUs) + mAnchorTimeMediaUs);
+    int64_t positionUs = (mSeekTimeUs != 0) ? mSeekTimeUs : getMediaTimeUs(nowUs);
 
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatPosition);
@@ -716,6 +1561,14 @@ void DashPlayer::Renderer::notifyPosition(bool isEOS) {
 }
 
 void DashPlayer::Renderer::notifySeekPosition(int64_t seekTime){
+  sp<AMessage> msg = new AMessage(kWhatSeekPosition, id());
+  msg->setInt64("seekTimeUs", seekTime);
+  msg->post();
+}
+
+void DashPlayer::Renderer::onSeekPosition(const sp<AMessage> &msg){
+  int64_t seekTime;
+  CHECK(msg->findInt64("seekTimeUs", &seekTime));
   mSeekTimeUs = seekTime;
   int64_t nowUs = ALooper::GetNowUs();
   mLastPositionUpdateUs = nowUs;
@@ -732,6 +1585,7 @@ void DashPlayer::Renderer::onPause() {
     CHECK(!mPaused);
 
     mDrainAudioQueuePending = false;
+    mOffloadPositionPending = false;
     ++mAudioQueueGeneration;
 
     mDrainVideoQueuePending = false;
@@ -739,6 +1593,7 @@ void DashPlayer::Renderer::onPause() {
 
     if (mHasAudio) {
         mAudioSink->pause();
+        mAudioClock->reset();
     }
 
     DPR_MSG_LOW("now paused audio queue has %d entries, video has %d entries",
@@ -746,6 +1601,7 @@ void DashPlayer::Renderer::onPause() {
 
     mPaused = true;
     mWasPaused = true;
+    mLastPresentTimeUs = -1ll;
 
     if(mStats != NULL) {
         int64_t positionUs;
@@ -753,7 +1609,7 @@ void DashPlayer::Renderer::onPause() {
             positionUs = -1000;
         } else {
             int64_t nowUs = ALooper::GetNowUs();
-            positionUs = (nowUs - mAnchorTimeRealUs) + mAnchorTimeMediaUs;
+            positionUs = getMediaTimeUs(nowUs);
         }
 
         mStats->logPause(positionUs);
@@ -767,6 +1623,7 @@ void DashPlayer::Renderer::onResume() {
 
     if (mHasAudio) {
         mAudioSink->start();
+        mAudioClock->reset();
     }
 
     mPaused = false;
@@ -778,6 +1635,8 @@ void DashPlayer::Renderer::onResume() {
     if (!mVideoQueue.empty()) {
         postDrainVideoQueue();
     }
+
+    postOffloadPositionPoll();
 }
 
 void DashPlayer::Renderer::registerStats(sp<DashPlayerStats> stats) {
@@ -787,8 +1646,30 @@ void DashPlayer::Renderer::registerStats(sp<DashPlayerStats> stats) {
     mStats = stats;
 }
 
+// Called before the renderer starts handling messages.
+void DashPlayer::Renderer::setFrameDropController(
+        const sp<DashFrameDropController> &controller) {
+    mDropController = controller;
+    if (mDropController != NULL) {
+        mDropController->setRenderWindowUs(mAVSyncDelayWindowUs);
+    }
+}
+
 status_t DashPlayer::Renderer::setMediaPresence(bool audio, bool bValue)
 {
+   sp<AMessage> msg = new AMessage(kWhatSetMediaPresence, id());
+   msg->setInt32("audio", static_cast<int32_t>(audio));
+   msg->setInt32("present", static_cast<int32_t>(bValue));
+   msg->post();
+   return OK;
+}
+
+void DashPlayer::Renderer::onSetMediaPresence(const sp<AMessage> &msg)
+{
+   int32_t audio;
+   int32_t bValue;
+   CHECK(msg->findInt32("audio", &audio));
+   CHECK(msg->findInt32("present", &bValue));
    if (audio)
    {
       DPR_MSG_LOW("mHasAudio set to %d from %d",bValue,mHasAudio);
@@ -799,7 +1680,6 @@ status_t DashPlayer::Renderer::setMediaPresence(bool audio, bool bValue)
      DPR_MSG_LOW("mHasVideo set to %d from %d",bValue,mHasVideo);
      mHasVideo = bValue;
    }
-   return OK;
 }
 
 }  // namespace android
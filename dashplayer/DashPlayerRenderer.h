@@ -19,6 +19,11 @@
 #define DASHPLAYER_RENDERER_H_
 
 #include "DashPlayer.h"
+#include "DashAudioClock.h"
+#include "DashAudioRing.h"
+#include "DashRingQueue.h"
+#include "DashTimeStretcher.h"
+#include "DashVideoFrameScheduler.h"
 
 namespace android {
 
@@ -31,6 +36,7 @@ struct DashPlayer::Renderer : public AHandler {
     void queueBuffer(
             bool audio,
             const sp<ABuffer> &buffer,
+            const sp<BufferInfo> &info,
             const sp<AMessage> &notifyConsumed);
 
     void queueEOS(bool audio, status_t finalResult);
@@ -45,10 +51,38 @@ struct DashPlayer::Renderer : public AHandler {
     void resume();
     void notifySeekPosition(int64_t seekTime);
 
+    // To be passed to AudioSink::open(). NULL unless the renderer was
+    // created in pull mode (persist.dash.audio.callback or
+    // persist.dash.audio.offload), the cookie is the renderer itself.
+    MediaPlayerBase::AudioSink::AudioCallback getAudioSinkCallback() const;
+
+    // Audio buffers are compressed access units for an offloading sink,
+    // which must have been opened with getAudioSinkCallback().
+    void setAudioOffload(bool offload);
+
+    // Media time advances at rate times real time, 0.5 to 2.0. Decoded
+    // audio is time-stretched to match, an offloaded stream asks to be
+    // torn down through kWhatAudioOffloadTearDown first.
+    void setPlaybackRate(float rate);
+
+    // Compressed access units the offloading sink had not played when
+    // offload ended, oldest first, each with "timeUs" in its meta.
+    struct AudioReplay : public RefBase {
+        List<sp<ABuffer> > mAccessUnits;
+    };
+
+    // Stops the offloading sink where it is, without a flush. Answered
+    // with kWhatAudioOffloadEnded, carrying "resumeUs", the media time the
+    // sink got to (-1 if it played nothing), and "replay", an AudioReplay
+    // starting with the access unit that contains it.
+    void endAudioOffload();
+
     enum {
         kWhatEOS                = 'eos ',
         kWhatFlushComplete      = 'fluC',
         kWhatPosition           = 'posi',
+        kWhatAudioOffloadTearDown = 'aOTD',
+        kWhatAudioOffloadEnded  = 'aOEd',
     };
 
 protected:
@@ -66,6 +100,17 @@ private:
         kWhatAudioSinkChanged   = 'auSC',
         kWhatPause              = 'paus',
         kWhatResume             = 'resm',
+        kWhatTimeDiscontinuity  = 'tDis',
+        kWhatSetMediaPresence   = 'mPrs',
+        kWhatSeekPosition       = 'seeP',
+        kWhatAudioRingLow       = 'arLo',
+        kWhatSetAudioOffload    = 'aOfl',
+        kWhatAudioOffloadDrained = 'aOfD',
+        kWhatAudioOffloadEnd    = 'aOfE',
+        kWhatAudioOffloadTorn   = 'aOfT',
+        kWhatOffloadPosition    = 'aOfP',
+        kWhatSetPlaybackRate    = 'sRat',
+        kWhatEndAudioOffload    = 'aOfX',
     };
 
     struct QueueEntry {
@@ -73,14 +118,53 @@ private:
         sp<AMessage> mNotifyConsumed;
         size_t mOffset;
         status_t mFinalResult;
+        int64_t mTimeUs;  // cached from the buffer's BufferInfo
     };
 
     static const int64_t kMinPositionUpdateDelayUs;
 
+    // kWhatQueueBuffer messages are recycled once handled, queueBuffer()
+    // is called from the player thread so the pool needs its own lock.
+    Mutex mQueueBufferMsgLock;
+    Vector<sp<AMessage> > mQueueBufferMsgs;
+
     sp<MediaPlayerBase::AudioSink> mAudioSink;
+    sp<DashAudioClock> mAudioClock;
+
+    // Staging for coalesced audio sink writes, and the consumed
+    // notifications of the buffers written during one drain.
+    int64_t mAudioStagingUs;
+    sp<ABuffer> mAudioStaging;
+    DashRingQueue<sp<AMessage> > mAudioConsumed;
+
+    // Pull mode only: decoded PCM waits here for the AudioSink callback,
+    // which asks for a refill once the ring is half empty.
+    sp<DashAudioRing> mAudioRing;
+    volatile int32_t mAudioRingRefillArmed;
+    uint32_t mAudioRingReadBase;  // ring bytes read before the current sink
+    volatile int32_t mAudioSinkCallbacks;  // since the last audio wakeup
+
+    // Offload: the ring carries compressed audio, the position comes from
+    // the sink's timestamps relative to the first access unit written.
+    // EOS is reported once the sink has played everything out.
+    bool mAudioOffload;
+    int64_t mOffloadStartMediaUs;
+    uint32_t mOffloadStartFrames;
+    bool mOffloadEOSPending;
+    status_t mOffloadFinalResult;
+    volatile int32_t mAudioOffloadEOS;  // set once the EOS entry was reached
+    bool mOffloadPositionPending;
+
+    // Copies of the access units written to the ring since the one the
+    // sink is playing, for endAudioOffload(). Trimmed as the position
+    // advances, the trimmed buffers are reused.
+    DashRingQueue<QueueEntry> mOffloadHistory;
+    DashRingQueue<sp<ABuffer> > mOffloadHistoryFree;
     sp<AMessage> mNotify;
-    List<QueueEntry> mAudioQueue;
-    List<QueueEntry> mVideoQueue;
+    // Ring buffers grow to the decoder's buffer count and then stop
+    // allocating, a List would allocate a node per frame.
+    DashRingQueue<QueueEntry> mAudioQueue;
+    DashRingQueue<QueueEntry> mVideoQueue;
     uint32_t mNumFramesWritten;
 
     bool mDrainAudioQueuePending;
@@ -99,6 +183,7 @@ private:
     bool mHasAudio;
     bool mHasVideo;
     bool mSyncQueues;
+    int64_t mStartSyncBeginUs;  // discontinuity time while awaiting first A/V
 
     bool mIsFirstVideoframeReceived;
     bool mPendingPostAudioDrains;
@@ -106,38 +191,86 @@ private:
     bool mPaused;
     bool mWasPaused; // if paused then store the info
 
+    // Presentation times are snapped to vsync and frames are handed to the
+    // codec a little early with a render timestamp, so pacing no longer
+    // depends on looper timer accuracy. See persist.dash.vsync.align.
+    bool mAlignToVsync;
+    sp<DashVideoFrameScheduler> mVideoScheduler;
+    int64_t mLastPresentTimeUs;       // for the pacing jitter statistics
+    int64_t mLastPresentMediaTimeUs;
+
     int64_t mLastPositionUpdateUs;
     int64_t mVideoLateByUs;
     int64_t mAVSyncDelayWindowUs;
 
+    // Created once the rate leaves 1x and kept until the next flush, so
+    // returning to 1x does not skip the input it holds.
+    float mPlaybackRate;
+    sp<DashTimeStretcher> mTimeStretcher;
+
     bool onDrainAudioQueue();
+    bool onDrainOffloadQueue();
+    void updateOffloadAnchor();
+    void recordOffloadHistory(const QueueEntry &entry);
+    void trimOffloadHistory();
+    void clearOffloadHistory();
+    void onEndAudioOffload();
+    void postOffloadPositionPoll();
+    void onSetAudioOffload(const sp<AMessage> &msg);
+    void onAudioOffloadDrained();
+    void onAudioOffloadEnd();
+    void recordAudioWakeup();
+    void onSetPlaybackRate(const sp<AMessage> &msg);
+    bool stretchAudioEntry(QueueEntry *entry);
+    uint32_t getAudioMediaSampleRate() const;
+    int64_t getRealTimeUs(int64_t mediaTimeUs) const;
+    int64_t getMediaTimeUs(int64_t realTimeUs) const;
+    int64_t getPendingPlayoutUs();
+    void writeAudioStaging(size_t *staged);
+    void writeToAudioSink(const void *data, size_t size);
+
+    static size_t AudioSinkCallback(
+            MediaPlayerBase::AudioSink *audioSink,
+            void *buffer, size_t size, void *cookie,
+            MediaPlayerBase::AudioSink::cb_event_t event);
+    size_t fillAudioSinkBuffer(void *buffer, size_t size);
+    void notifyAudioConsumed();
     void postDrainAudioQueue(int64_t delayUs = 0);
 
     void onDrainVideoQueue();
     void postDrainVideoQueue();
+    int64_t getVsyncPeriodUs() const;
     void onQueueBuffer(const sp<AMessage> &msg);
+    void recycleQueueBufferMsg(const sp<AMessage> &msg);
     void onQueueEOS(const sp<AMessage> &msg);
     void onFlush(const sp<AMessage> &msg);
     void onAudioSinkChanged();
     void onPause();
     void onResume();
+    void onTimeDiscontinuity();
+    void onSetMediaPresence(const sp<AMessage> &msg);
+    void onSeekPosition(const sp<AMessage> &msg);
 
     void notifyEOS(bool audio, status_t finalResult);
     void notifyFlushComplete(bool audio);
     void notifyPosition(bool isEOS = false);
     void notifyVideoLateBy(int64_t lateByUs);
 
-    void flushQueue(List<QueueEntry> *queue);
+    void flushQueue(DashRingQueue<QueueEntry> *queue);
     bool dropBufferWhileFlushing(bool audio, const sp<AMessage> &msg);
+    void syncQueues();
+    void trimAudioEntry(QueueEntry *entry, int64_t startUs);
     void syncQueuesDone();
 
     // for qualcomm statistics profiling
   public:
     void registerStats(sp<DashPlayerStats> stats);
+    void setFrameDropController(const sp<DashFrameDropController> &controller);
     status_t setMediaPresence(bool audio, bool bValue);
 
   private:
     sp<DashPlayerStats> mStats;
+    sp<DashFrameDropController> mDropController;
     int mLogLevel;
 
     DISALLOW_EVIL_CONSTRUCTORS(Renderer);
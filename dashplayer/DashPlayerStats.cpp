@@ -28,17 +28,32 @@
  */
 
 #include "DashPlayerStats.h"
+#include <cutils/atomic.h>
+#include <time.h>
 
 #define NO_MIMETYPE_AVAILABLE "N/A"
 
 namespace android {
 
+// upper bounds of the pacing jitter buckets, the last one is open ended
+static const int64_t kPacingJitterBoundsUs[] = {
+    1000, 2000, 4000, 8000, 16667, 33333
+};
+
+static const char *kSeekStageNames[] = {
+    "source", "flush", "input", "output", "render"
+};
+
+static volatile int32_t sMessageAllocations = 0;
+
 DashPlayerStats::DashPlayerStats() {
       Mutex::Autolock autoLock(mStatsLock);
       mMIME = new char[strlen(NO_MIMETYPE_AVAILABLE)+1];
       strlcpy(mMIME,NO_MIMETYPE_AVAILABLE, strlen(NO_MIMETYPE_AVAILABLE)+1);
       mNumVideoFramesDecoded = 0;
       mNumVideoFramesDropped = 0;
+      mNumFramesDroppedBeforeDecode = 0;
+      mNumFramesDroppedAtRender = 0;
       mConsecutiveFramesDropped = 0;
       mCatchupTimeStart = 0;
       mNumTimesSyncLoss = 0;
@@ -56,9 +71,32 @@ DashPlayerStats::DashPlayerStats() {
       mTotalTime = 0;
       mFirstFrameTime = 0;
       mTotalRenderingFrames = 0;
+      mMessageAllocationsAtStart = android_atomic_acquire_load(&sMessageAllocations);
+      mMessageAllocationsAtFirstFrame = mMessageAllocationsAtStart;
       mBufferingEvent = false;
       mFd = -1;
       mFileOut = NULL;
+      memset(mPacingJitter, 0, sizeof(mPacingJitter));
+      mAudioOffload = false;
+      mAudioWakeups = 0;
+      mAudioPathStartUs = getTimeOfDayUs();
+      mAudioPathStartCpuUs = getProcessCpuTimeUs();
+      mNumStartSyncs = 0;
+      mStartSyncTotalUs = 0;
+      mStartSyncMaxUs = 0;
+      mNumWarmReinits = 0;
+      mWarmReinitTotalUs = 0;
+      mWarmReinitMaxUs = 0;
+      mNumColdReinits = 0;
+      mColdReinitTotalUs = 0;
+      mColdReinitMaxUs = 0;
+      mSeekStartUs = -1;
+      for (size_t i = 0; i < kNumSeekStages; ++i) {
+          mSeekStageUs[i] = -1;
+      }
+      mNumSeeks = 0;
+      memset(mSeekStageTotalUs, 0, sizeof(mSeekStageTotalUs));
+      memset(mSeekStageMaxUs, 0, sizeof(mSeekStageMaxUs));
 }
 
 DashPlayerStats::~DashPlayerStats() {
@@ -106,6 +144,46 @@ void DashPlayerStats::notifySeek() {
     Mutex::Autolock autoLock(mStatsLock);
     mFirstFrameLatencyStartUs = getTimeOfDayUs();
     mSeekPerformed = true;
+    mSeekStartUs = mFirstFrameLatencyStartUs;
+    for (size_t i = 0; i < kNumSeekStages; ++i) {
+        mSeekStageUs[i] = -1;
+    }
+}
+
+void DashPlayerStats::markSeekStage(SeekStage stage) {
+    Mutex::Autolock autoLock(mStatsLock);
+    if (mSeekStartUs < 0 || mSeekStageUs[stage] >= 0) {
+        return;
+    }
+    mSeekStageUs[stage] = getTimeOfDayUs() - mSeekStartUs;
+    if (stage != kSeekStageRender) {
+        return;
+    }
+
+    // A stage that was skipped over, e.g. the flush of a track that had
+    // no decoder, completed no later than the one after it.
+    for (int i = kSeekStageRender - 1; i >= 0; --i) {
+        if (mSeekStageUs[i] < 0 || mSeekStageUs[i] > mSeekStageUs[i + 1]) {
+            mSeekStageUs[i] = mSeekStageUs[i + 1];
+        }
+    }
+
+    ++mNumSeeks;
+    for (size_t i = 0; i < kNumSeekStages; ++i) {
+        mSeekStageTotalUs[i] += mSeekStageUs[i];
+        if (mSeekStageUs[i] > mSeekStageMaxUs[i]) {
+            mSeekStageMaxUs[i] = mSeekStageUs[i];
+        }
+    }
+
+    if (mFileOut) {
+        fprintf(mFileOut, "Seek stages (ms):");
+        for (size_t i = 0; i < kNumSeekStages; ++i) {
+            fprintf(mFileOut, " %s %.2f", kSeekStageNames[i], mSeekStageUs[i] / 1E3);
+        }
+        fprintf(mFileOut, "\n");
+    }
+    mSeekStartUs = -1;
 }
 
 void DashPlayerStats::notifyBufferingEvent() {
@@ -120,12 +198,68 @@ void DashPlayerStats::incrementTotalFrames() {
 
 void DashPlayerStats::incrementTotalRenderingFrames() {
     Mutex::Autolock autoLock(mStatsLock);
-    mTotalRenderingFrames++;
+    if (mTotalRenderingFrames++ == 0) {
+        mMessageAllocationsAtFirstFrame =
+            android_atomic_acquire_load(&sMessageAllocations);
+    }
 }
 
 void DashPlayerStats::incrementDroppedFrames() {
     Mutex::Autolock autoLock(mStatsLock);
     mNumVideoFramesDropped++;
+    mNumFramesDroppedBeforeDecode++;
+}
+
+// static
+void DashPlayerStats::countMessageAllocations(int32_t count) {
+    android_atomic_add(count, &sMessageAllocations);
+}
+
+void DashPlayerStats::recordPacingJitter(int64_t jitterUs) {
+    Mutex::Autolock autoLock(mStatsLock);
+    if (jitterUs < 0) {
+        jitterUs = -jitterUs;
+    }
+
+    size_t i = 0;
+    while (i < kNumPacingJitterBuckets - 1 && jitterUs >= kPacingJitterBoundsUs[i]) {
+        ++i;
+    }
+    ++mPacingJitter[i];
+}
+
+void DashPlayerStats::setAudioOffload(bool offload) {
+    Mutex::Autolock autoLock(mStatsLock);
+    mAudioOffload = offload;
+    mAudioWakeups = 0;
+    mAudioPathStartUs = getTimeOfDayUs();
+    mAudioPathStartCpuUs = getProcessCpuTimeUs();
+}
+
+void DashPlayerStats::recordAudioWakeups(uint32_t count) {
+    Mutex::Autolock autoLock(mStatsLock);
+    mAudioWakeups += count;
+}
+
+void DashPlayerStats::recordStartSyncLatency(int64_t latencyUs) {
+    Mutex::Autolock autoLock(mStatsLock);
+    ++mNumStartSyncs;
+    mStartSyncTotalUs += latencyUs;
+    if (latencyUs > mStartSyncMaxUs) {
+        mStartSyncMaxUs = latencyUs;
+    }
+}
+
+void DashPlayerStats::recordDecoderReinit(int64_t latencyUs, bool warm) {
+    Mutex::Autolock autoLock(mStatsLock);
+    uint32_t *count = warm ? &mNumWarmReinits : &mNumColdReinits;
+    int64_t *totalUs = warm ? &mWarmReinitTotalUs : &mColdReinitTotalUs;
+    int64_t *maxUs = warm ? &mWarmReinitMaxUs : &mColdReinitMaxUs;
+    ++*count;
+    *totalUs += latencyUs;
+    if (latencyUs > *maxUs) {
+        *maxUs = latencyUs;
+    }
 }
 
 void DashPlayerStats::logStatistics() {
@@ -135,9 +269,50 @@ void DashPlayerStats::logStatistics() {
         fprintf(mFileOut, "Mime Type: %s\n",mMIME);
         fprintf(mFileOut, "Number of total frames: %llu\n",(unsigned long long)mTotalFrames);
         fprintf(mFileOut, "Number of frames dropped: %lld\n",(signed long long)mNumVideoFramesDropped);
+        fprintf(mFileOut, "    before decode: %lld\n",(signed long long)mNumFramesDroppedBeforeDecode);
+        fprintf(mFileOut, "    at render: %lld\n",(signed long long)mNumFramesDroppedAtRender);
         fprintf(mFileOut, "Number of frames rendered: %llu\n",(unsigned long long)mTotalRenderingFrames);
         fprintf(mFileOut, "Percentage dropped: %.2f\n",
                            mTotalFrames == 0 ? 0.0 : (double)mNumVideoFramesDropped / (double)mTotalFrames);
+        int32_t messageAllocations = android_atomic_acquire_load(&sMessageAllocations);
+        fprintf(mFileOut, "Pooled messages allocated: %d, after the first frame: %d\n",
+                           messageAllocations - mMessageAllocationsAtStart,
+                           messageAllocations - mMessageAllocationsAtFirstFrame);
+        fprintf(mFileOut, "Frame pacing jitter histogram:\n");
+        for (size_t i = 0; i < kNumPacingJitterBuckets; ++i) {
+            if (i < kNumPacingJitterBuckets - 1) {
+                fprintf(mFileOut, "    < %6.2f ms: %llu\n",
+                        kPacingJitterBoundsUs[i] / 1E3, (unsigned long long)mPacingJitter[i]);
+            } else {
+                fprintf(mFileOut, "   >= %6.2f ms: %llu\n",
+                        kPacingJitterBoundsUs[i - 1] / 1E3, (unsigned long long)mPacingJitter[i]);
+            }
+        }
+        double audioMinutes = (getTimeOfDayUs() - mAudioPathStartUs) / 60E6;
+        fprintf(mFileOut, "Audio path: %s\n", mAudioOffload ? "offload" : "decoded");
+        fprintf(mFileOut, "Audio wakeups per minute: %.1f\n",
+                           audioMinutes <= 0 ? 0.0 : mAudioWakeups / audioMinutes);
+        fprintf(mFileOut, "Process CPU per minute: %.1f ms\n",
+                           audioMinutes <= 0 ? 0.0
+                               : (getProcessCpuTimeUs() - mAudioPathStartCpuUs) / 1E3 / audioMinutes);
+        fprintf(mFileOut, "Discontinuity to first A/V frame: %u times, avg %.2f ms, max %.2f ms\n",
+                           mNumStartSyncs,
+                           mNumStartSyncs == 0 ? 0.0 : mStartSyncTotalUs / 1E3 / mNumStartSyncs,
+                           mStartSyncMaxUs / 1E3);
+        fprintf(mFileOut, "Decoder re-init, pooled: %u times, avg %.2f ms, max %.2f ms\n",
+                           mNumWarmReinits,
+                           mNumWarmReinits == 0 ? 0.0 : mWarmReinitTotalUs / 1E3 / mNumWarmReinits,
+                           mWarmReinitMaxUs / 1E3);
+        fprintf(mFileOut, "Decoder re-init, allocated: %u times, avg %.2f ms, max %.2f ms\n",
+                           mNumColdReinits,
+                           mNumColdReinits == 0 ? 0.0 : mColdReinitTotalUs / 1E3 / mNumColdReinits,
+                           mColdReinitMaxUs / 1E3);
+        fprintf(mFileOut, "Seek to first frame: %u times\n", mNumSeeks);
+        for (size_t i = 0; i < kNumSeekStages; ++i) {
+            fprintf(mFileOut, "    %-6s avg %.2f ms, max %.2f ms\n", kSeekStageNames[i],
+                               mNumSeeks == 0 ? 0.0 : mSeekStageTotalUs[i] / 1E3 / mNumSeeks,
+                               mSeekStageMaxUs[i] / 1E3);
+        }
         fprintf(mFileOut, "=====================================================\n");
     }
 }
@@ -163,6 +338,7 @@ void DashPlayerStats::logSeek(int64_t seekTimeUs) {
 void DashPlayerStats::recordLate(int64_t ts, int64_t clock, int64_t delta, int64_t anchorTime) {
     Mutex::Autolock autoLock(mStatsLock);
     mNumVideoFramesDropped++;
+    mNumFramesDroppedAtRender++;
     mConsecutiveFramesDropped++;
     if (mConsecutiveFramesDropped == 1){
       mCatchupTimeStart = (uint32_t)anchorTime;
@@ -249,6 +425,14 @@ int64_t DashPlayerStats::getTimeOfDayUs() {
     return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
 }
 
+int64_t DashPlayerStats::getProcessCpuTimeUs() {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 // WARNING: Most private functions are only thread-safe within mStatsLock
 inline void DashPlayerStats::logFirstFrame() {
     fprintf(mFileOut, "=====================================================\n");
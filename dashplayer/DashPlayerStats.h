@@ -42,6 +42,17 @@ class DashPlayerStats : public RefBase {
     DashPlayerStats();
     ~DashPlayerStats();
 
+    // Stages of a seek, each timed from notifySeek() to when it was first
+    // reached. Reaching kSeekStageRender completes the seek.
+    enum SeekStage {
+        kSeekStageSource,   // the source repositioned
+        kSeekStageFlush,    // decoders flushed or shut down
+        kSeekStageInput,    // first video access unit queued to the decoder
+        kSeekStageOutput,   // first decoded video frame not skipped
+        kSeekStageRender,   // first video frame rendered
+        kNumSeekStages,
+    };
+
     void setMime(const char* mime);
     void setVeryFirstFrame(bool vff);
     void notifySeek();
@@ -50,6 +61,7 @@ class DashPlayerStats : public RefBase {
     void logStatistics();
     void logPause(int64_t positionUs);
     void logSeek(int64_t seekTimeUs);
+    void markSeekStage(SeekStage stage);
     void recordLate(int64_t ts, int64_t clock, int64_t delta, int64_t anchorTime);
     void recordOnTime(int64_t ts, int64_t clock, int64_t delta);
     void logSyncLoss();
@@ -59,6 +71,17 @@ class DashPlayerStats : public RefBase {
     void incrementTotalRenderingFrames();
     void notifyBufferingEvent();
     void setFileDescAndOutputStream(int fd);
+    void recordPacingJitter(int64_t jitterUs);
+    void setAudioOffload(bool offload);
+    void recordAudioWakeups(uint32_t count);
+    void recordStartSyncLatency(int64_t latencyUs);
+    void recordDecoderReinit(int64_t latencyUs, bool warm);
+    static int64_t getProcessCpuTimeUs();
+
+    // Counts messages the decoder and renderer message pools had to
+    // allocate, for any player in the process. Once the first frame is
+    // rendered this only grows when a flush rebuilds the pools.
+    static void countMessageAllocations(int32_t count);
 
   private:
     void logFirstFrame();
@@ -71,6 +94,8 @@ class DashPlayerStats : public RefBase {
     char* mMIME;
     int64_t mNumVideoFramesDecoded;
     int64_t mNumVideoFramesDropped;
+    int64_t mNumFramesDroppedBeforeDecode;  // non-reference, never decoded
+    int64_t mNumFramesDroppedAtRender;      // decoded but too late
     int64_t mConsecutiveFramesDropped;
     int64_t mCatchupTimeStart;
     uint32_t mNumTimesSyncLoss;
@@ -88,9 +113,46 @@ class DashPlayerStats : public RefBase {
     int64_t mTotalTime;
     int64_t mFirstFrameTime;
     uint64_t mTotalRenderingFrames;
+    int32_t mMessageAllocationsAtStart;
+    int32_t mMessageAllocationsAtFirstFrame;
     bool mBufferingEvent;
     int mFd;
     FILE *mFileOut;
+
+    // Deviation of each frame's presentation interval from its media
+    // interval, bucketed by the upper bounds in kPacingJitterBoundsUs.
+    enum { kNumPacingJitterBuckets = 7 };
+    uint64_t mPacingJitter[kNumPacingJitterBuckets];
+
+    // Audio path cost since the current path was selected, reported per
+    // minute so decoded and offloaded playback can be compared.
+    bool mAudioOffload;
+    uint64_t mAudioWakeups;
+    int64_t mAudioPathStartUs;
+    int64_t mAudioPathStartCpuUs;
+
+    // From a time discontinuity to the first video frame rendered with
+    // audio aligned to it.
+    uint32_t mNumStartSyncs;
+    int64_t mStartSyncTotalUs;
+    int64_t mStartSyncMaxUs;
+
+    // From a format change to the next decoder's first output, by whether
+    // that decoder was started from the pool or allocated.
+    uint32_t mNumWarmReinits;
+    int64_t mWarmReinitTotalUs;
+    int64_t mWarmReinitMaxUs;
+    uint32_t mNumColdReinits;
+    int64_t mColdReinitTotalUs;
+    int64_t mColdReinitMaxUs;
+
+    // Stages of the seek in progress, -1 until reached, and of all seeks
+    // that rendered a frame.
+    int64_t mSeekStartUs;  // -1 with no seek in progress
+    int64_t mSeekStageUs[kNumSeekStages];
+    uint32_t mNumSeeks;
+    int64_t mSeekStageTotalUs[kNumSeekStages];
+    int64_t mSeekStageMaxUs[kNumSeekStages];
 };
 
 } // namespace android
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_RING_QUEUE_H_
+
+#define DASH_RING_QUEUE_H_
+
+#include <media/stagefright/foundation/ADebug.h>
+
+namespace android {
+
+// FIFO over a contiguous power-of-two array. Once it has grown to the
+// largest number of entries outstanding, which for renderer queues is
+// bounded by the decoder's buffer count, pushing and popping no longer
+// allocate. Not thread safe. Pointers and references to entries stay
+// valid until the entry is popped or the next push_back() that grows.
+template<typename T>
+class DashRingQueue {
+public:
+    explicit DashRingQueue(size_t capacity = 16)
+        : mItems(NULL),
+          mCapacity(0),
+          mHead(0),
+          mSize(0) {
+        grow(capacity);
+    }
+
+    ~DashRingQueue() {
+        delete[] mItems;
+    }
+
+    bool empty() const { return mSize == 0; }
+    size_t size() const { return mSize; }
+    size_t capacity() const { return mCapacity; }
+
+    // i counts from the front
+    T &operator[](size_t i) {
+        CHECK_LT(i, mSize);
+        return mItems[(mHead + i) & (mCapacity - 1)];
+    }
+
+    const T &operator[](size_t i) const {
+        CHECK_LT(i, mSize);
+        return mItems[(mHead + i) & (mCapacity - 1)];
+    }
+
+    T &front() { return (*this)[0]; }
+    const T &front() const { return (*this)[0]; }
+
+    void push_back(const T &item) {
+        if (mSize == mCapacity) {
+            grow(mCapacity * 2);
+        }
+        mItems[(mHead + mSize) & (mCapacity - 1)] = item;
+        ++mSize;
+    }
+
+    void pop_front() {
+        CHECK(mSize > 0);
+        // drop the references the entry holds right away
+        mItems[mHead] = T();
+        mHead = (mHead + 1) & (mCapacity - 1);
+        --mSize;
+    }
+
+private:
+    T *mItems;
+    size_t mCapacity;
+    size_t mHead;
+    size_t mSize;
+
+    void grow(size_t capacity) {
+        size_t newCapacity = 1;
+        while (newCapacity < capacity) {
+            newCapacity <<= 1;
+        }
+
+        T *items = new T[newCapacity];
+        for (size_t i = 0; i < mSize; ++i) {
+            items[i] = mItems[(mHead + i) & (mCapacity - 1)];
+        }
+
+        delete[] mItems;
+        mItems = items;
+        mCapacity = newCapacity;
+        mHead = 0;
+    }
+
+    DashRingQueue(const DashRingQueue &);
+    DashRingQueue &operator=(const DashRingQueue &);
+};
+
+}  // namespace android
+
+#endif  // DASH_RING_QUEUE_H_
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashTimeStretcher"
+
+#include "DashTimeStretcher.h"
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <math.h>
+#include <string.h>
+
+namespace android {
+
+// A segment spans a few pitch periods of speech and music, hops are half
+// of it. The search only has to find the phase, a few ms either side.
+static const int64_t kSegmentUs = 20000ll;
+static const int64_t kSearchUs = 3000ll;
+
+// Coarse search steps are kept at about this rate, then refined.
+static const uint32_t kSearchStepRate = 6000;
+
+static const float kMinRate = 0.5f;
+static const float kMaxRate = 2.0f;
+
+// A counted loop over contiguous samples into one wide accumulator,
+// without branches, so the compiler can vectorize it. Channels are
+// interleaved and simply summed over.
+static inline int64_t DotProduct(
+        const int16_t *a, const int16_t *b, size_t numSamples) {
+    int64_t sum = 0;
+    for (size_t i = 0; i < numSamples; ++i) {
+        sum += (int32_t)a[i] * (int32_t)b[i];
+    }
+    return sum;
+}
+
+DashTimeStretcher::DashTimeStretcher(uint32_t sampleRate, size_t numChannels)
+    : mSampleRate(sampleRate),
+      mNumChannels(numChannels),
+      mHopFrames((size_t)(sampleRate * kSegmentUs / 2 / 1000000ll)),
+      mSearchFrames((size_t)(sampleRate * kSearchUs / 1000000ll)),
+      mSearchStep(sampleRate / kSearchStepRate),
+      mRate(1.0f),
+      mInputStartFrame(0),
+      mHaveTail(false),
+      mAnalysisFrame(0),
+      mBaseTimeUs(-1ll) {
+    CHECK_GT(sampleRate, 0u);
+    CHECK_GT(numChannels, 0u);
+    if (mHopFrames == 0) {
+        mHopFrames = 1;
+    }
+    if (mSearchStep == 0) {
+        mSearchStep = 1;
+    }
+    mTail.insertAt((int16_t)0, 0, mHopFrames * mNumChannels);
+}
+
+DashTimeStretcher::~DashTimeStretcher() {
+}
+
+void DashTimeStretcher::setRate(float rate) {
+    if (rate < kMinRate) {
+        rate = kMinRate;
+    } else if (rate > kMaxRate) {
+        rate = kMaxRate;
+    }
+    mRate = rate;
+}
+
+void DashTimeStretcher::reset() {
+    mInput.clear();
+    mInputStartFrame = 0;
+    mHaveTail = false;
+    mAnalysisFrame = 0;
+    mBaseTimeUs = -1ll;
+}
+
+sp<ABuffer> DashTimeStretcher::process(
+        const int16_t *data, size_t numFrames, int64_t timeUs,
+        int64_t *outTimeUs) {
+    if (mBaseTimeUs < 0) {
+        mBaseTimeUs = timeUs;
+    }
+    mInput.appendArray(data, numFrames * mNumChannels);
+
+    size_t hopSamples = mHopFrames * mNumChannels;
+    if (!mHaveTail) {
+        if (mInput.size() < hopSamples) {
+            return NULL;
+        }
+        // Starting from the first half segment itself makes the first
+        // hop at the nominal position reproduce the input.
+        memcpy(mTail.editArray(), mInput.array(), hopSamples * sizeof(int16_t));
+        mHaveTail = true;
+    }
+
+    int64_t endFrame = mInputStartFrame + (int64_t)(mInput.size() / mNumChannels);
+    int64_t lookaheadFrames = (int64_t)(mSearchFrames + 2 * mHopFrames);
+    double hopInputFrames = mHopFrames * (double)mRate;
+
+    size_t numHops = 0;
+    for (double frame = mAnalysisFrame;
+            (int64_t)frame + lookaheadFrames <= endFrame;
+            frame += hopInputFrames) {
+        ++numHops;
+    }
+    if (numHops == 0) {
+        return NULL;
+    }
+
+    *outTimeUs = mBaseTimeUs + (int64_t)(mAnalysisFrame * 1E6 / mSampleRate);
+
+    sp<ABuffer> out = new ABuffer(numHops * hopSamples * sizeof(int16_t));
+    int16_t *dst = (int16_t *)out->data();
+    for (size_t i = 0; i < numHops; ++i) {
+        int64_t nominalFrame = (int64_t)mAnalysisFrame;
+        int64_t frame = nominalFrame;
+        if (mRate != 1.0f) {
+            int64_t firstFrame = nominalFrame - (int64_t)mSearchFrames;
+            if (firstFrame < mInputStartFrame) {
+                firstFrame = mInputStartFrame;
+            }
+            frame = findBestFrame(
+                    nominalFrame, firstFrame, nominalFrame + (int64_t)mSearchFrames);
+        }
+
+        const int16_t *segment =
+            mInput.array() + (frame - mInputStartFrame) * mNumChannels;
+        overlapAdd(segment, dst);
+        dst += hopSamples;
+
+        memcpy(mTail.editArray(), segment + hopSamples, hopSamples * sizeof(int16_t));
+        mAnalysisFrame += hopInputFrames;
+    }
+
+    // Only the search range before the next nominal position is needed.
+    int64_t keepFrame = (int64_t)mAnalysisFrame - (int64_t)mSearchFrames;
+    if (keepFrame > mInputStartFrame) {
+        size_t dropFrames = (size_t)(keepFrame - mInputStartFrame);
+        if (dropFrames > mInput.size() / mNumChannels) {
+            dropFrames = mInput.size() / mNumChannels;
+        }
+        mInput.removeItemsAt(0, dropFrames * mNumChannels);
+        mInputStartFrame += dropFrames;
+    }
+
+    return out;
+}
+
+// Coarse search over the whole range, then every frame around the best.
+int64_t DashTimeStretcher::findBestFrame(
+        int64_t nominalFrame, int64_t firstFrame, int64_t lastFrame) const {
+    int64_t bestFrame = nominalFrame;
+    double bestScore = matchScore(nominalFrame);
+
+    for (int64_t frame = firstFrame; frame <= lastFrame;
+            frame += (int64_t)mSearchStep) {
+        double score = matchScore(frame);
+        if (score > bestScore) {
+            bestScore = score;
+            bestFrame = frame;
+        }
+    }
+
+    int64_t coarseFrame = bestFrame;
+    for (int64_t frame = coarseFrame - (int64_t)mSearchStep + 1;
+            frame < coarseFrame + (int64_t)mSearchStep; ++frame) {
+        if (frame < firstFrame || frame > lastFrame || frame == coarseFrame) {
+            continue;
+        }
+        double score = matchScore(frame);
+        if (score > bestScore) {
+            bestScore = score;
+            bestFrame = frame;
+        }
+    }
+
+    return bestFrame;
+}
+
+// Correlation of the half segment at frame with the tail, normalized by
+// the candidate's energy so loud candidates are not favoured.
+double DashTimeStretcher::matchScore(int64_t frame) const {
+    size_t hopSamples = mHopFrames * mNumChannels;
+    const int16_t *segment =
+        mInput.array() + (frame - mInputStartFrame) * mNumChannels;
+
+    int64_t correlation = DotProduct(mTail.array(), segment, hopSamples);
+    int64_t energy = DotProduct(segment, segment, hopSamples);
+    return (double)correlation / sqrt((double)energy + 1.0);
+}
+
+// Linear Q15 crossfade from the tail into the segment's first half.
+void DashTimeStretcher::overlapAdd(const int16_t *segment, int16_t *out) const {
+    const int16_t *tail = mTail.array();
+    for (size_t i = 0; i < mHopFrames; ++i) {
+        int32_t fadeIn = (int32_t)((i << 15) / mHopFrames);
+        int32_t fadeOut = (1 << 15) - fadeIn;
+        for (size_t c = 0; c < mNumChannels; ++c) {
+            size_t j = i * mNumChannels + c;
+            out[j] = (int16_t)((tail[j] * fadeOut + segment[j] * fadeIn) >> 15);
+        }
+    }
+}
+
+}  // namespace android
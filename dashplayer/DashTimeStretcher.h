@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_TIME_STRETCHER_H_
+
+#define DASH_TIME_STRETCHER_H_
+
+#include <media/stagefright/foundation/ABase.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+struct ABuffer;
+
+// Changes the tempo of 16 bit interleaved PCM without changing its pitch
+// (WSOLA). Output is produced in hops of half a segment. Every hop is
+// the next segment of input, taken from around where the playback rate
+// says it should start, at the offset that best matches the end of the
+// previous one, crossfaded into it. Input is taken as contiguous, call
+// reset() at discontinuities. Not thread safe.
+struct DashTimeStretcher : public RefBase {
+    DashTimeStretcher(uint32_t sampleRate, size_t numChannels);
+
+    uint32_t getSampleRate() const { return mSampleRate; }
+    size_t getChannelCount() const { return mNumChannels; }
+
+    // 0.5 to 2.0, takes effect with the next hop.
+    void setRate(float rate);
+    float getRate() const { return mRate; }
+
+    // Drops buffered input, the next input starts a new timeline.
+    void reset();
+
+    // Appends numFrames of input starting at media time timeUs and
+    // stretches as much as it can. Returns the output, or NULL while too
+    // little input is buffered, with the media time of its first frame
+    // in *outTimeUs. About a segment and the search range of input
+    // stays buffered.
+    sp<ABuffer> process(
+            const int16_t *data, size_t numFrames, int64_t timeUs,
+            int64_t *outTimeUs);
+
+protected:
+    virtual ~DashTimeStretcher();
+
+private:
+    uint32_t mSampleRate;
+    size_t mNumChannels;
+    size_t mHopFrames;     // output per hop, half a segment
+    size_t mSearchFrames;  // either side of the nominal position
+    size_t mSearchStep;    // of the coarse search
+    float mRate;
+
+    Vector<int16_t> mInput;
+    int64_t mInputStartFrame;  // frame index of mInput[0] on the timeline
+
+    // Second half of the last segment, the next one is crossfaded into it.
+    Vector<int16_t> mTail;
+    bool mHaveTail;
+
+    double mAnalysisFrame;  // where the next segment nominally starts
+    int64_t mBaseTimeUs;    // media time of frame 0, -1 before any input
+
+    int64_t findBestFrame(int64_t nominalFrame, int64_t firstFrame,
+            int64_t lastFrame) const;
+    double matchScore(int64_t frame) const;
+    void overlapAdd(const int16_t *segment, int16_t *out) const;
+
+    DISALLOW_EVIL_CONSTRUCTORS(DashTimeStretcher);
+};
+
+}  // namespace android
+
+#endif  // DASH_TIME_STRETCHER_H_
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashVideoFrameScheduler"
+
+#include "DashVideoFrameScheduler.h"
+#include <binder/IServiceManager.h>
+#include <gui/ISurfaceComposer.h>
+#include <ui/DisplayStatInfo.h>
+#include <utils/Log.h>
+
+namespace android {
+
+// Display timing is re-read this often to follow refresh rate changes and
+// clock drift between vsync and the system clock.
+static const nsecs_t kVsyncRefreshPeriodNs = 1000000000ll;
+
+// Sanity bounds for the reported period, 24 .. 240 Hz.
+static const nsecs_t kMinVsyncPeriodNs = 4000000ll;
+static const nsecs_t kMaxVsyncPeriodNs = 42000000ll;
+
+DashVideoFrameScheduler::DashVideoFrameScheduler()
+    : mVsyncTime(0),
+      mVsyncPeriod(0),
+      mVsyncRefreshAt(0) {
+}
+
+DashVideoFrameScheduler::~DashVideoFrameScheduler() {
+}
+
+bool DashVideoFrameScheduler::init() {
+    sp<IServiceManager> sm = defaultServiceManager();
+    if (sm == NULL) {
+        return false;
+    }
+
+    sp<IBinder> binder = sm->checkService(String16("SurfaceFlinger"));
+    mComposer = interface_cast<ISurfaceComposer>(binder);
+    if (mComposer == NULL) {
+        ALOGW("SurfaceFlinger not available, not aligning to vsync");
+        return false;
+    }
+
+    return updateVsync();
+}
+
+bool DashVideoFrameScheduler::updateVsync() {
+    mVsyncRefreshAt = systemTime(SYSTEM_TIME_MONOTONIC) + kVsyncRefreshPeriodNs;
+
+    DisplayStatInfo stats;
+    sp<IBinder> display =
+        mComposer->getBuiltInDisplay(ISurfaceComposer::eDisplayIdMain);
+    if (mComposer->getDisplayStats(display, &stats) != OK
+            || stats.vsyncPeriod < kMinVsyncPeriodNs
+            || stats.vsyncPeriod > kMaxVsyncPeriodNs) {
+        ALOGW("no usable display timing, not aligning to vsync");
+        mVsyncPeriod = 0;
+        return false;
+    }
+
+    mVsyncTime = stats.vsyncTime;
+    mVsyncPeriod = stats.vsyncPeriod;
+    ALOGV("vsync period %lld ns, phase %lld ns",
+            (long long)mVsyncPeriod, (long long)(mVsyncTime % mVsyncPeriod));
+    return true;
+}
+
+nsecs_t DashVideoFrameScheduler::schedule(nsecs_t renderTimeNs) {
+    if (mComposer == NULL) {
+        return renderTimeNs;
+    }
+
+    if (systemTime(SYSTEM_TIME_MONOTONIC) >= mVsyncRefreshAt) {
+        updateVsync();
+    }
+
+    if (mVsyncPeriod == 0) {
+        return renderTimeNs;
+    }
+
+    // round to the nearest edge, on either side of the last known vsync
+    nsecs_t offset = renderTimeNs - mVsyncTime + mVsyncPeriod / 2;
+    nsecs_t n = offset / mVsyncPeriod;
+    if (offset < 0 && offset % mVsyncPeriod != 0) {
+        --n;
+    }
+    return mVsyncTime + n * mVsyncPeriod;
+}
+
+}  // namespace android
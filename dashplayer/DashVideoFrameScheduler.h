@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DASH_VIDEO_FRAME_SCHEDULER_H_
+
+#define DASH_VIDEO_FRAME_SCHEDULER_H_
+
+#include <utils/RefBase.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class ISurfaceComposer;
+
+// Aligns video presentation times to the display refresh. The vsync period
+// and phase are read from SurfaceFlinger and refreshed periodically to
+// follow drift, all times are systemTime(SYSTEM_TIME_MONOTONIC) based.
+struct DashVideoFrameScheduler : public RefBase {
+    DashVideoFrameScheduler();
+
+    // Returns false if display timing is unavailable, schedule() then
+    // passes times through unchanged.
+    bool init();
+
+    // Returns the vsync edge closest to renderTimeNs.
+    nsecs_t schedule(nsecs_t renderTimeNs);
+
+    // 0 until init() succeeded.
+    nsecs_t getVsyncPeriod() const { return mVsyncPeriod; }
+
+protected:
+    virtual ~DashVideoFrameScheduler();
+
+private:
+    sp<ISurfaceComposer> mComposer;
+    nsecs_t mVsyncTime;       // a recent vsync edge
+    nsecs_t mVsyncPeriod;
+    nsecs_t mVsyncRefreshAt;  // when to re-read display timing
+
+    bool updateVsync();
+
+    DashVideoFrameScheduler(const DashVideoFrameScheduler &);
+    DashVideoFrameScheduler &operator=(const DashVideoFrameScheduler &);
+};
+
+}  // namespace android
+
+#endif  // DASH_VIDEO_FRAME_SCHEDULER_H_
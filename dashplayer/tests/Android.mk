@@ -0,0 +1,94 @@
+LOCAL_PATH:= $(call my-dir)
+
+# ---------------------------------------------------------------------------------
+#            Host tests and benchmarks, run from out/host/<os>-x86/bin
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := DashPacketRingBenchmark.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := libcutils
+
+LOCAL_CPPFLAGS += -std=gnu++11
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE := dashplayer_packet_ring_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := DashPacketRing_test.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_STATIC_LIBRARIES := libcutils
+
+LOCAL_CPPFLAGS += -std=gnu++11
+LOCAL_LDLIBS += -lpthread
+
+LOCAL_MODULE := dashplayer_packet_ring_test
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        DashCaptionParser_test.cpp \
+        ../DashCaptionParser.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_MODULE := dashplayer_caption_parser_test
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        DashCaptionParserBenchmark.cpp \
+        ../DashCaptionParser.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_CPPFLAGS += -std=gnu++11
+
+LOCAL_MODULE := dashplayer_caption_parser_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := \
+        DashNALClassifier_test.cpp \
+        ../DashNALClassifier.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_MODULE := dashplayer_nal_classifier_test
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_NATIVE_TEST)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES := DashBufferInfoBenchmark.cpp
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/..
+
+LOCAL_MODULE := dashplayer_buffer_info_benchmark
+
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// String-keyed lookups made for one decoded video frame, from the decoder's
+// output callback to the renderer's video drain, before and after the
+// timestamp and flags moved from the frame's meta() into a BufferInfo
+// posted with the messages.
+//
+// AMessage and ABuffer are not built for the host, so both paths run
+// against a shim with AMessage's layout: a flat item array searched by
+// name. The shim counts every find and set, split between a frame's meta()
+// and the messages that carry it. Each path replays the calls of
+//
+//   Decoder::onOutputBufferAvailable
+//   DashPlayer::renderBuffer
+//   Renderer::queueBuffer, onQueueBuffer
+//   Renderer::postDrainVideoQueue, onDrainVideoQueue
+//
+// for a frame without extradata, played without a pending seek. Only the
+// counts are reported: the shim has none of AMessage's reference counting
+// or item allocation, so its timings would say little about the device.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+struct Counts {
+    size_t mFinds;
+    size_t mSets;
+};
+
+// AMessage's storage: at most 64 items, looked up by name in order.
+struct ShimStore {
+    explicit ShimStore(Counts *counts) : mCounts(counts), mNumItems(0) {}
+
+    void clear() {
+        mNumItems = 0;
+    }
+
+    void set(const char *name, int64_t value) {
+        ++mCounts->mSets;
+        Item *item = findItem(name);
+        if (item == NULL) {
+            item = &mItems[mNumItems++];
+            item->mName = name;
+        }
+        item->mValue = value;
+    }
+
+    bool find(const char *name, int64_t *value) {
+        ++mCounts->mFinds;
+        Item *item = findItem(name);
+        if (item == NULL) {
+            return false;
+        }
+        *value = item->mValue;
+        return true;
+    }
+
+private:
+    struct Item {
+        const char *mName;
+        int64_t mValue;
+    };
+
+    Item *findItem(const char *name) {
+        for (size_t i = 0; i < mNumItems; ++i) {
+            if (!strcmp(mItems[i].mName, name)) {
+                return &mItems[i];
+            }
+        }
+        return NULL;
+    }
+
+    Counts *mCounts;
+    Item mItems[64];
+    size_t mNumItems;
+};
+
+const int64_t kWhatDrainThisBuffer = 4;
+
+struct BufferInfo {
+    int64_t mTimeUs;
+    uint32_t mFlags;
+    intptr_t mGraphicBuffer;
+};
+
+struct Path {
+    Path()
+        : mMeta(&mMetaCounts),
+          mNotify(&mMessageCounts),
+          mReply(&mMessageCounts),
+          mQueueBuffer(&mMessageCounts) {
+        memset(&mMetaCounts, 0, sizeof(mMetaCounts));
+        memset(&mMessageCounts, 0, sizeof(mMessageCounts));
+        mMeta.set("graphic-buffer", 1);
+        mMetaCounts.mSets = 0;
+    }
+
+    Counts mMetaCounts;
+    Counts mMessageCounts;
+    ShimStore mMeta;          // the output buffer's meta()
+    ShimStore mNotify;        // kWhatDrainThisBuffer
+    ShimStore mReply;         // kWhatRenderBuffer
+    ShimStore mQueueBuffer;   // kWhatQueueBuffer
+    BufferInfo mInfo;
+};
+
+// The output path before BufferInfo, everything in the frame's meta().
+int64_t RenderFrameBefore(Path *p, int64_t timeUs) {
+    int64_t sink = 0;
+    int64_t value = 0;
+
+    // Decoder::onOutputBufferAvailable
+    int64_t graphicBuffer = 0;
+    p->mMeta.find("graphic-buffer", &graphicBuffer);
+    p->mMeta.clear();
+    p->mMeta.set("timeUs", timeUs);
+    p->mReply.set("buffer-ix", 0);
+    p->mReply.set("generation", 1);
+    p->mNotify.set("what", kWhatDrainThisBuffer);
+    p->mMeta.set("graphic-buffer", graphicBuffer);
+    p->mNotify.set("buffer", 1);
+    p->mNotify.set("reply", 1);
+
+    // DashPlayer::renderBuffer
+    p->mNotify.find("reply", &value);
+    p->mNotify.find("buffer", &value);
+    int64_t extradata = 0;
+    p->mMeta.find("extradata", &extradata);
+    sink += extradata;
+
+    // Renderer::queueBuffer, onQueueBuffer
+    p->mQueueBuffer.set("audio", 0);
+    p->mQueueBuffer.set("buffer", 1);
+    p->mQueueBuffer.set("notifyConsumed", 1);
+    p->mQueueBuffer.find("audio", &value);
+    p->mQueueBuffer.find("buffer", &value);
+    p->mQueueBuffer.find("notifyConsumed", &value);
+    p->mMeta.find("timeUs", &value);
+    sink += value;
+
+    // Renderer::postDrainVideoQueue, onDrainVideoQueue
+    p->mMeta.find("timeUs", &value);
+    sink += value;
+    p->mMeta.find("timeUs", &value);
+    sink += value;
+    return sink;
+}
+
+// The output path now, the frame's meta() is only read for extradata.
+int64_t RenderFrameAfter(Path *p, int64_t timeUs) {
+    int64_t sink = 0;
+    int64_t value = 0;
+
+    // Decoder::onOutputBufferAvailable
+    BufferInfo *info = &p->mInfo;
+    info->mTimeUs = timeUs;
+    info->mFlags = 0;
+    info->mGraphicBuffer = 0;
+    p->mReply.clear();
+    p->mReply.set("buffer-ix", 0);
+    p->mReply.set("generation", 1);
+    p->mNotify.set("what", kWhatDrainThisBuffer);
+    p->mNotify.set("buffer", 1);
+    p->mNotify.set("info", (intptr_t)info);
+    p->mNotify.set("reply", 1);
+
+    // DashPlayer::renderBuffer
+    p->mNotify.find("reply", &value);
+    p->mNotify.find("buffer", &value);
+    p->mNotify.find("info", &value);
+    info = (BufferInfo *)(intptr_t)value;
+    sink += info->mFlags;
+
+    // Renderer::queueBuffer, onQueueBuffer caches the timestamp
+    p->mQueueBuffer.set("audio", 0);
+    p->mQueueBuffer.set("buffer", 1);
+    p->mQueueBuffer.set("info", (intptr_t)info);
+    p->mQueueBuffer.set("notifyConsumed", 1);
+    p->mQueueBuffer.find("audio", &value);
+    p->mQueueBuffer.find("buffer", &value);
+    p->mQueueBuffer.find("notifyConsumed", &value);
+    p->mQueueBuffer.find("info", &value);
+    int64_t entryTimeUs = ((BufferInfo *)(intptr_t)value)->mTimeUs;
+    sink += entryTimeUs;
+
+    // Renderer::postDrainVideoQueue, onDrainVideoQueue
+    sink += entryTimeUs;
+    sink += entryTimeUs;
+    return sink;
+}
+
+typedef int64_t (*FrameFunc)(Path *p, int64_t timeUs);
+
+// Returns false if a frame did not carry its timestamp through.
+bool Run(const char *label, FrameFunc func, size_t frames) {
+    Path path;
+    for (size_t i = 0; i < frames; ++i) {
+        int64_t timeUs = (int64_t)i * 33333;
+        if (func(&path, timeUs) != 3 * timeUs) {
+            fprintf(stderr, "%s: frame %zu lost its timestamp\n", label, i);
+            return false;
+        }
+    }
+
+    size_t meta = path.mMetaCounts.mFinds + path.mMetaCounts.mSets;
+    size_t message = path.mMessageCounts.mFinds + path.mMessageCounts.mSets;
+    printf("%-8s %10.2f %10.2f %10.2f %10.2f %10.2f\n", label,
+            (double)path.mMetaCounts.mFinds / frames,
+            (double)path.mMetaCounts.mSets / frames,
+            (double)path.mMessageCounts.mFinds / frames,
+            (double)path.mMessageCounts.mSets / frames,
+            (double)(meta + message) / frames);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t frames = 1000;
+    if (argc > 1) {
+        frames = (size_t)atol(argv[1]);
+    }
+
+    printf("%-8s %10s %10s %10s %10s %10s\n",
+            "/frame", "meta find", "meta set", "msg find", "msg set", "total");
+    if (!Run("before", RenderFrameBefore, frames)
+            || !Run("after", RenderFrameAfter, frames)) {
+        return 1;
+    }
+    return 0;
+}
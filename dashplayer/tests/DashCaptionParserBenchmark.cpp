@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Cost of finding the cc_data of an ATSC A/53 caption SEI, per call:
+//
+//   marker     DashFindByte(), a checked memchr(), against memchr() itself
+//              and a plain byte loop, the way the caption extractor used to
+//              scan, on cc_data sizes from a single caption pair to the 31
+//              pair maximum and on larger buffers
+//   payload    FindCEACCData() on a whole T.35 payload
+
+#include "DashCaptionParser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+}
+
+const uint8_t kHeader[] = {
+    0xB5, 0x00, 0x31, 0x47, 0x41, 0x39, 0x34, 0x03
+};
+
+const uint8_t *ScalarFindByte(const uint8_t *data, size_t size, uint8_t value) {
+    for (size_t i = 0; i < size; ++i) {
+        if (data[i] == value) {
+            return data + i;
+        }
+    }
+    return NULL;
+}
+
+const uint8_t *MemchrFindByte(const uint8_t *data, size_t size, uint8_t value) {
+    return (const uint8_t *)memchr(data, value, size);
+}
+
+typedef const uint8_t *(*FindFunc)(const uint8_t *data, size_t size, uint8_t value);
+
+// Keeps the compiler from inlining, hoisting or dropping the calls.
+volatile uintptr_t gSink;
+
+double TimeFind(FindFunc func, const std::vector<uint8_t> &buffer, size_t iterations) {
+    FindFunc volatile find = func;
+    uintptr_t sink = 0;
+    int64_t startNs = NowNs();
+    for (size_t i = 0; i < iterations; ++i) {
+        sink += (uintptr_t)find(&buffer[0], buffer.size(), 0xFF);
+    }
+    double ns = (double)(NowNs() - startNs) / iterations;
+    gSink = sink;
+    return ns;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t budget = 200000000;  // bytes scanned per measurement
+    if (argc > 1) {
+        budget = (size_t)atol(argv[1]);
+    }
+
+    static const size_t kSizes[] = { 3, 15, 93, 1024, 65536 };
+
+    printf("%-12s %12s %12s %12s\n", "ns/call", "byte loop", "memchr", "DashFindByte");
+    for (size_t s = 0; s < sizeof(kSizes) / sizeof(kSizes[0]); ++s) {
+        // marker in the last byte, the whole buffer is scanned
+        std::vector<uint8_t> buffer(kSizes[s], 0xFC);
+        buffer.back() = 0xFF;
+
+        size_t iterations = budget / buffer.size() + 1;
+        char label[32];
+        snprintf(label, sizeof(label), "%zu bytes", buffer.size());
+        printf("%-12s %12.1f %12.1f %12.1f\n", label,
+                TimeFind(ScalarFindByte, buffer, iterations),
+                TimeFind(MemchrFindByte, buffer, iterations),
+                TimeFind(DashFindByte, buffer, iterations));
+    }
+
+    // 31 caption pairs (cc_count 31), the largest A/53 payload
+    std::vector<uint8_t> payload(kHeader, kHeader + sizeof(kHeader));
+    payload.resize(payload.size() + 93, 0xFC);
+    payload.push_back(0xFF);
+
+    size_t iterations = budget / payload.size() + 1;
+    size_t found = 0;
+    int64_t startNs = NowNs();
+    for (size_t i = 0; i < iterations; ++i) {
+        const uint8_t *ccData;
+        size_t ccSize;
+        if (FindCEACCData(&payload[0], payload.size(), &ccData, &ccSize)) {
+            found += ccSize;
+        }
+    }
+    double ns = (double)(NowNs() - startNs) / iterations;
+    if (found != iterations * 93) {
+        fprintf(stderr, "FindCEACCData failed\n");
+        return 1;
+    }
+    printf("FindCEACCData, 93 bytes of cc_data: %.1f ns/call\n", ns);
+    return 0;
+}
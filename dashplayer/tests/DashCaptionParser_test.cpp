@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DashCaptionParser.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+const uint8_t kHeader[] = {
+    0xB5, 0x00, 0x31, 0x47, 0x41, 0x39, 0x34, 0x03
+};
+
+// T.35 payload: the GA94 header, ccSize bytes of cc_data, the 0xFF marker
+// and trailing bytes that belong to whatever follows in the SEI.
+std::vector<uint8_t> MakePayload(size_t ccSize) {
+    std::vector<uint8_t> payload(kHeader, kHeader + sizeof(kHeader));
+    for (size_t i = 0; i < ccSize; ++i) {
+        payload.push_back((uint8_t)(0x40 + (i % 0x80)));
+    }
+    payload.push_back(0xFF);
+    payload.push_back(0x80);
+    return payload;
+}
+
+}  // namespace
+
+TEST(DashCaptionParserTest, FindsCCData) {
+    std::vector<uint8_t> payload = MakePayload(9);
+    const uint8_t *ccData = NULL;
+    size_t ccSize = 0;
+    ASSERT_TRUE(FindCEACCData(&payload[0], payload.size(), &ccData, &ccSize));
+    EXPECT_EQ(&payload[sizeof(kHeader)], ccData);
+    EXPECT_EQ(9u, ccSize);
+}
+
+TEST(DashCaptionParserTest, FindsCCDataLongerThanAVectorBlock) {
+    std::vector<uint8_t> payload = MakePayload(3 * 31);
+    const uint8_t *ccData = NULL;
+    size_t ccSize = 0;
+    ASSERT_TRUE(FindCEACCData(&payload[0], payload.size(), &ccData, &ccSize));
+    EXPECT_EQ(3u * 31, ccSize);
+}
+
+TEST(DashCaptionParserTest, RejectsOtherRegisteredUserData) {
+    for (size_t i = 0; i < sizeof(kHeader); ++i) {
+        std::vector<uint8_t> payload = MakePayload(9);
+        payload[i] ^= 0x01;
+        const uint8_t *ccData = NULL;
+        size_t ccSize = 0;
+        EXPECT_FALSE(FindCEACCData(&payload[0], payload.size(), &ccData, &ccSize))
+                << "header byte " << i;
+    }
+}
+
+TEST(DashCaptionParserTest, RejectsShortPayloads) {
+    const uint8_t *ccData = NULL;
+    size_t ccSize = 0;
+    EXPECT_FALSE(FindCEACCData(NULL, 64, &ccData, &ccSize));
+    EXPECT_FALSE(FindCEACCData(kHeader, 0, &ccData, &ccSize));
+    EXPECT_FALSE(FindCEACCData(kHeader, sizeof(kHeader) - 1, &ccData, &ccSize));
+    EXPECT_FALSE(FindCEACCData(kHeader, sizeof(kHeader), &ccData, &ccSize));
+}
+
+TEST(DashCaptionParserTest, RejectsEmptyCCData) {
+    std::vector<uint8_t> payload = MakePayload(0);
+    const uint8_t *ccData = NULL;
+    size_t ccSize = 0;
+    EXPECT_FALSE(FindCEACCData(&payload[0], payload.size(), &ccData, &ccSize));
+}
+
+// The marker sits one byte past the payload the caller passes in, where a
+// reader ignoring size would find it.
+TEST(DashCaptionParserTest, DoesNotReadPastSize) {
+    for (size_t ccSize = 1; ccSize < 80; ++ccSize) {
+        std::vector<uint8_t> payload = MakePayload(ccSize);
+        size_t size = sizeof(kHeader) + ccSize;
+        const uint8_t *ccData = NULL;
+        size_t found = 0;
+        EXPECT_FALSE(FindCEACCData(&payload[0], size, &ccData, &found))
+                << "cc data of " << ccSize << " bytes";
+        EXPECT_TRUE(FindCEACCData(&payload[0], size + 1, &ccData, &found));
+        EXPECT_EQ(ccSize, found);
+    }
+}
+
+// Every size and alignment up to a few 16 byte vector blocks, with the
+// value absent, present once and present more than once.
+TEST(DashCaptionParserTest, FindByteMatchesMemchr) {
+    std::vector<uint8_t> buffer(160 + 16);
+    for (size_t align = 0; align < 16; ++align) {
+        for (size_t size = 0; size <= 160; ++size) {
+            uint8_t *data = &buffer[align];
+            memset(&buffer[0], 0x00, buffer.size());
+            for (size_t i = 0; i < size; ++i) {
+                data[i] = (uint8_t)(i & 0x7F);
+            }
+            EXPECT_EQ(memchr(data, 0xFF, size), DashFindByte(data, size, 0xFF));
+
+            for (size_t pos = 0; pos < size; ++pos) {
+                data[pos] = 0xFF;
+                if (pos + 17 < size) {
+                    data[pos + 17] = 0xFF;
+                }
+                ASSERT_EQ(memchr(data, 0xFF, size), DashFindByte(data, size, 0xFF))
+                        << "align " << align << " size " << size << " pos " << pos;
+                data[pos] = (uint8_t)(pos & 0x7F);
+                if (pos + 17 < size) {
+                    data[pos + 17] = (uint8_t)((pos + 17) & 0x7F);
+                }
+            }
+        }
+    }
+}
+
+// A match just past size must not be reported.
+TEST(DashCaptionParserTest, FindByteStopsAtSize) {
+    std::vector<uint8_t> buffer(64, 0x00);
+    for (size_t size = 0; size < 48; ++size) {
+        buffer[size] = 0xFF;
+        EXPECT_EQ(NULL, DashFindByte(&buffer[0], size, 0xFF)) << "size " << size;
+        buffer[size] = 0x00;
+    }
+}
+
+// An empty range finds nothing, whatever the pointer.
+TEST(DashCaptionParserTest, FindByteEmptyRange) {
+    const uint8_t value = 0xFF;
+    EXPECT_EQ(NULL, DashFindByte(NULL, 0, 0xFF));
+    EXPECT_EQ(NULL, DashFindByte(NULL, 16, 0xFF));
+    EXPECT_EQ(NULL, DashFindByte(&value, 0, 0xFF));
+}
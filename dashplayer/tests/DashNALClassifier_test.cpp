@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DashNALClassifier.h"
+
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+typedef std::vector<uint8_t> Stream;
+
+// Appends an Annex B NAL unit: a 4 or 3 byte start code, the header bytes
+// and payloadSize bytes that cannot form a start code.
+void AppendNAL(Stream *stream, const uint8_t *header, size_t headerSize,
+        size_t payloadSize = 8, bool longStartCode = true) {
+    if (longStartCode) {
+        stream->push_back(0x00);
+    }
+    stream->push_back(0x00);
+    stream->push_back(0x00);
+    stream->push_back(0x01);
+    stream->insert(stream->end(), header, header + headerSize);
+    for (size_t i = 0; i < payloadSize; ++i) {
+        stream->push_back((uint8_t)(0x80 | i));
+    }
+}
+
+void AppendAVC(Stream *stream, unsigned nalRefIdc, unsigned nalType,
+        size_t payloadSize = 8) {
+    uint8_t header = (uint8_t)((nalRefIdc << 5) | nalType);
+    AppendNAL(stream, &header, 1, payloadSize);
+}
+
+// SVC prefix NAL unit (type 14) carrying temporal_id.
+void AppendAVCPrefix(Stream *stream, int temporalId, bool svcExtension = true) {
+    const uint8_t header[] = {
+        0x6E,                               // nal_ref_idc 3, type 14
+        (uint8_t)(svcExtension ? 0x80 : 0x00),
+        0x00,
+        (uint8_t)(temporalId << 5),
+    };
+    AppendNAL(stream, header, sizeof(header), 2);
+}
+
+void AppendHEVC(Stream *stream, unsigned nalType, int temporalId,
+        size_t payloadSize = 8) {
+    const uint8_t header[] = {
+        (uint8_t)(nalType << 1),
+        (uint8_t)(temporalId + 1),          // nuh_layer_id 0
+    };
+    AppendNAL(stream, header, sizeof(header), payloadSize);
+}
+
+// Exactly as big as the stream, so the sanitizers catch reads past it.
+bool Classify(const Stream &stream, DashNALInfo::Codec codec, DashNALInfo *info) {
+    if (stream.empty()) {
+        return ClassifyNALUnits(NULL, 0, codec, info);
+    }
+    uint8_t *data = new uint8_t[stream.size()];
+    memcpy(data, &stream[0], stream.size());
+    bool found = ClassifyNALUnits(data, stream.size(), codec, info);
+    delete[] data;
+    return found;
+}
+
+}  // namespace
+
+TEST(DashNALClassifierTest, AVCIDRAfterParameterSets) {
+    Stream stream;
+    AppendAVC(&stream, 0, 9);   // access unit delimiter
+    AppendAVC(&stream, 3, 7);   // SPS
+    AppendAVC(&stream, 3, 8);   // PPS
+    AppendAVC(&stream, 0, 6);   // SEI
+    AppendAVC(&stream, 3, 5);   // IDR slice
+
+    DashNALInfo info;
+    ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_TRUE(info.mValid);
+    EXPECT_EQ(5u, info.mNALType);
+    EXPECT_TRUE(info.mIsRandomAccess);
+    EXPECT_FALSE(info.mIsNonReference);
+    EXPECT_EQ(0, info.mTemporalId);
+}
+
+TEST(DashNALClassifierTest, AVCReferenceByNalRefIdc) {
+    for (unsigned nalRefIdc = 0; nalRefIdc < 4; ++nalRefIdc) {
+        Stream stream;
+        AppendAVC(&stream, nalRefIdc, 1);
+
+        DashNALInfo info;
+        ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+        EXPECT_EQ(1u, info.mNALType);
+        EXPECT_FALSE(info.mIsRandomAccess);
+        EXPECT_EQ(nalRefIdc == 0, info.mIsNonReference) << "nal_ref_idc " << nalRefIdc;
+    }
+}
+
+TEST(DashNALClassifierTest, AVCFirstSliceDecides) {
+    Stream stream;
+    AppendAVC(&stream, 0, 1);
+    AppendAVC(&stream, 3, 5);
+
+    DashNALInfo info;
+    ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_EQ(1u, info.mNALType);
+    EXPECT_TRUE(info.mIsNonReference);
+}
+
+TEST(DashNALClassifierTest, AVCWithoutSlice) {
+    Stream stream;
+    AppendAVC(&stream, 3, 7);
+    AppendAVC(&stream, 3, 8);
+    AppendAVC(&stream, 0, 6);
+    AppendAVC(&stream, 0, 12);  // filler data
+
+    DashNALInfo info;
+    info.mValid = true;
+    EXPECT_FALSE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_FALSE(info.mValid);
+}
+
+TEST(DashNALClassifierTest, AVCEscapedStartCodeInSEI) {
+    // emulation prevention turns 00 00 01 into 00 00 03 01
+    const uint8_t sei[] = { 0x06, 0x05, 0x00, 0x00, 0x03, 0x01, 0x65, 0x88 };
+    Stream stream;
+    AppendNAL(&stream, sei, sizeof(sei), 0);
+    AppendAVC(&stream, 0, 1);
+
+    DashNALInfo info;
+    ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_EQ(1u, info.mNALType);
+    EXPECT_FALSE(info.mIsRandomAccess);
+}
+
+TEST(DashNALClassifierTest, AVCSVCPrefixTemporalId) {
+    for (int temporalId = 0; temporalId < 8; ++temporalId) {
+        Stream stream;
+        AppendAVCPrefix(&stream, temporalId);
+        AppendAVC(&stream, 2, 1);
+
+        DashNALInfo info;
+        ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+        EXPECT_EQ(1u, info.mNALType);
+        EXPECT_EQ(temporalId, info.mTemporalId);
+    }
+}
+
+TEST(DashNALClassifierTest, AVCPrefixWithoutSVCExtension) {
+    Stream stream;
+    AppendAVCPrefix(&stream, 5, false /* svcExtension */);
+    AppendAVC(&stream, 2, 1);
+
+    DashNALInfo info;
+    ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_EQ(0, info.mTemporalId);
+}
+
+TEST(DashNALClassifierTest, AVCTruncatedPrefixAtEnd) {
+    // the prefix's SVC extension is cut off by the end of the buffer
+    Stream stream;
+    AppendAVC(&stream, 2, 1);
+    const uint8_t prefix[] = { 0x6E, 0x80, 0x00 };
+    AppendNAL(&stream, prefix, sizeof(prefix), 0);
+
+    DashNALInfo info;
+    ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_EQ(0, info.mTemporalId);
+
+    Stream prefixOnly;
+    AppendNAL(&prefixOnly, prefix, sizeof(prefix), 0);
+    EXPECT_FALSE(Classify(prefixOnly, DashNALInfo::kCodecAVC, &info));
+}
+
+TEST(DashNALClassifierTest, HEVCRandomAccessTypes) {
+    for (unsigned nalType = 0; nalType < 32; ++nalType) {
+        Stream stream;
+        AppendHEVC(&stream, 32, 0);     // VPS
+        AppendHEVC(&stream, 33, 0);     // SPS
+        AppendHEVC(&stream, 34, 0);     // PPS
+        AppendHEVC(&stream, nalType, 0);
+
+        DashNALInfo info;
+        ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+        EXPECT_EQ(nalType, info.mNALType);
+        // BLA_W_LP 16 to RSV_IRAP_VCL23 23
+        EXPECT_EQ(nalType >= 16 && nalType <= 23, info.mIsRandomAccess)
+                << "nal_unit_type " << nalType;
+    }
+}
+
+TEST(DashNALClassifierTest, HEVCSubLayerNonReference) {
+    for (unsigned nalType = 0; nalType < 32; ++nalType) {
+        Stream stream;
+        AppendHEVC(&stream, nalType, 0);
+
+        DashNALInfo info;
+        ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+        // TRAIL_N 0, TSA_N 2, STSA_N 4, RADL_N 6, RASL_N 8, RSV_VCL_N10 to 14
+        EXPECT_EQ(nalType <= 14 && (nalType & 1) == 0, info.mIsNonReference)
+                << "nal_unit_type " << nalType;
+    }
+}
+
+TEST(DashNALClassifierTest, HEVCTrailNTemporalId) {
+    for (int temporalId = 0; temporalId < 7; ++temporalId) {
+        Stream stream;
+        AppendHEVC(&stream, 35, temporalId);    // access unit delimiter
+        AppendHEVC(&stream, 39, temporalId);    // prefix SEI
+        AppendHEVC(&stream, 0, temporalId);     // TRAIL_N
+
+        DashNALInfo info;
+        ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+        EXPECT_EQ(0u, info.mNALType);
+        EXPECT_TRUE(info.mIsNonReference);
+        EXPECT_FALSE(info.mIsRandomAccess);
+        EXPECT_EQ(temporalId, info.mTemporalId);
+    }
+}
+
+TEST(DashNALClassifierTest, HEVCForbiddenTemporalId) {
+    Stream stream;
+    const uint8_t header[] = { 0x02, 0x00 };    // TRAIL_R, nuh_temporal_id_plus1 0
+    AppendNAL(&stream, header, sizeof(header));
+    AppendHEVC(&stream, 1, 0);
+
+    DashNALInfo info;
+    EXPECT_FALSE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+    EXPECT_FALSE(info.mValid);
+}
+
+TEST(DashNALClassifierTest, HEVCTruncatedHeader) {
+    // a single header byte before the end of the buffer
+    Stream stream;
+    AppendHEVC(&stream, 32, 0);
+    const uint8_t header[] = { 0x26 };          // IDR_W_RADL, second byte missing
+    AppendNAL(&stream, header, sizeof(header), 0);
+
+    DashNALInfo info;
+    EXPECT_FALSE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+}
+
+TEST(DashNALClassifierTest, StartCodeAtBufferEdge) {
+    DashNALInfo info;
+
+    // nothing follows the start code
+    Stream bare;
+    AppendAVC(&bare, 3, 7);
+    bare.push_back(0x00);
+    bare.push_back(0x00);
+    bare.push_back(0x01);
+    EXPECT_FALSE(Classify(bare, DashNALInfo::kCodecAVC, &info));
+    EXPECT_FALSE(Classify(bare, DashNALInfo::kCodecHEVC, &info));
+
+    // the header is the last byte
+    Stream last;
+    AppendAVC(&last, 3, 7);
+    AppendAVC(&last, 3, 5, 0);
+    ASSERT_TRUE(Classify(last, DashNALInfo::kCodecAVC, &info));
+    EXPECT_TRUE(info.mIsRandomAccess);
+
+    // the header is the last two bytes
+    Stream lastTwo;
+    AppendHEVC(&lastTwo, 32, 0);
+    AppendHEVC(&lastTwo, 19, 0, 0);             // IDR_W_RADL
+    ASSERT_TRUE(Classify(lastTwo, DashNALInfo::kCodecHEVC, &info));
+    EXPECT_TRUE(info.mIsRandomAccess);
+}
+
+TEST(DashNALClassifierTest, StartCodeAtEveryOffset) {
+    // leading bytes shift the start code across the scanner's three byte
+    // strides, zeros make for partial start codes just before it
+    const uint8_t kFillers[] = { 0x00, 0x01, 0x02, 0x80, 0xFF };
+    const uint8_t kIDRHeader[] = { 0x65 };
+    for (size_t f = 0; f < sizeof(kFillers); ++f) {
+        for (size_t leading = 0; leading < 16; ++leading) {
+            Stream stream(leading, kFillers[f]);
+            AppendNAL(&stream, kIDRHeader, sizeof(kIDRHeader), 4, leading & 1);
+
+            DashNALInfo info;
+            ASSERT_TRUE(Classify(stream, DashNALInfo::kCodecAVC, &info))
+                    << "filler " << (int)kFillers[f] << " x" << leading;
+            EXPECT_EQ(5u, info.mNALType);
+        }
+    }
+}
+
+TEST(DashNALClassifierTest, EmptyAndNullBuffers) {
+    DashNALInfo info;
+    info.mValid = true;
+    info.mTemporalId = 3;
+    EXPECT_FALSE(ClassifyNALUnits(NULL, 64, DashNALInfo::kCodecAVC, &info));
+    EXPECT_FALSE(info.mValid);
+    EXPECT_EQ(0, info.mTemporalId);
+
+    const uint8_t data[] = { 0x00, 0x00, 0x01, 0x65 };
+    EXPECT_FALSE(ClassifyNALUnits(data, 0, DashNALInfo::kCodecAVC, &info));
+    EXPECT_FALSE(ClassifyNALUnits(data, 3, DashNALInfo::kCodecHEVC, &info));
+}
+
+TEST(DashNALClassifierTest, NoStartCode) {
+    Stream stream(64, 0x00);
+    stream.push_back(0x65);
+
+    DashNALInfo info;
+    EXPECT_FALSE(Classify(stream, DashNALInfo::kCodecAVC, &info));
+    EXPECT_FALSE(Classify(stream, DashNALInfo::kCodecHEVC, &info));
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per access unit cost of handing AUs from the source thread to the player
+// thread, before (a mutex and condition guarded list, as DashPacketSource
+// used to be) and after (DashPacketRing with DashPacketSource's waiting
+// handshake). Payloads are reference counted like sp<ABuffer>.
+//
+//   uncontended  one thread queues and dequeues, the pure per-AU overhead
+//   streaming    producer and consumer threads, back to back
+//   paced        4K60 video plus 48 kHz AAC audio at their real rates, the
+//                consumer asleep between AUs; wake-up latency per AU
+
+#include "DashPacketRing.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace android;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch()).count();
+}
+
+struct Entry {
+    Entry() : mTimeUs(-1), mSize(0), mIsDiscontinuity(false), mQueuedNs(0) {}
+
+    void releaseBuffer() { mBuffer.reset(); }
+
+    std::shared_ptr<std::vector<uint8_t> > mBuffer;
+    int64_t mTimeUs;
+    size_t mSize;
+    bool mIsDiscontinuity;
+    int64_t mQueuedNs;
+};
+
+// DashPacketSource before the ring.
+class ListQueue {
+public:
+    void push(const Entry &entry) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mEntries.push_back(entry);
+        mCondition.notify_one();
+    }
+
+    bool tryPop(Entry *entry) {
+        std::lock_guard<std::mutex> lock(mLock);
+        if (mEntries.empty()) {
+            return false;
+        }
+        *entry = mEntries.front();
+        mEntries.pop_front();
+        return true;
+    }
+
+    void pop(Entry *entry) {
+        std::unique_lock<std::mutex> lock(mLock);
+        while (mEntries.empty()) {
+            mCondition.wait(lock);
+        }
+        *entry = mEntries.front();
+        mEntries.pop_front();
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::list<Entry> mEntries;
+};
+
+// DashPacketSource's per-AU path on the ring.
+class RingQueue {
+public:
+    RingQueue() : mWaiting(0) {}
+
+    void push(const Entry &entry) {
+        while (!mRing.push(entry)) {
+            std::this_thread::yield();
+        }
+        android_memory_barrier();
+        if (android_atomic_acquire_load(&mWaiting)) {
+            std::lock_guard<std::mutex> lock(mLock);
+            mCondition.notify_one();
+        }
+    }
+
+    bool tryPop(Entry *entry) {
+        return mRing.pop(entry);
+    }
+
+    void pop(Entry *entry) {
+        if (mRing.pop(entry)) {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mLock);
+        for (;;) {
+            if (mRing.pop(entry)) {
+                return;
+            }
+            android_atomic_release_store(1, &mWaiting);
+            android_memory_barrier();
+            if (mRing.size() > 0) {
+                android_atomic_release_store(0, &mWaiting);
+                continue;
+            }
+            mCondition.wait(lock);
+            android_atomic_release_store(0, &mWaiting);
+        }
+    }
+
+private:
+    DashPacketRing<Entry, 1024> mRing;
+    volatile int32_t mWaiting;
+    std::mutex mLock;
+    std::condition_variable mCondition;
+};
+
+Entry MakeEntry(const std::shared_ptr<std::vector<uint8_t> > &buffer, int64_t timeUs) {
+    Entry entry;
+    entry.mBuffer = buffer;
+    entry.mTimeUs = timeUs;
+    entry.mSize = buffer->size();
+    return entry;
+}
+
+template<typename Queue>
+double Uncontended(size_t count) {
+    Queue queue;
+    std::shared_ptr<std::vector<uint8_t> > buffer(new std::vector<uint8_t>(4096));
+    Entry entry;
+
+    int64_t startNs = NowNs();
+    for (size_t i = 0; i < count; ++i) {
+        queue.push(MakeEntry(buffer, (int64_t)i));
+        if (!queue.tryPop(&entry)) {
+            abort();
+        }
+    }
+    return (double)(NowNs() - startNs) / count;
+}
+
+template<typename Queue>
+double Streaming(size_t count) {
+    Queue queue;
+    std::shared_ptr<std::vector<uint8_t> > buffer(new std::vector<uint8_t>(4096));
+
+    int64_t startNs = NowNs();
+    std::thread producer([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            queue.push(MakeEntry(buffer, (int64_t)i));
+        }
+    });
+
+    Entry entry;
+    for (size_t i = 0; i < count; ++i) {
+        queue.pop(&entry);
+        if (entry.mTimeUs != (int64_t)i) {
+            fprintf(stderr, "out of order: %lld at %zu\n", (long long)entry.mTimeUs, i);
+            abort();
+        }
+    }
+    producer.join();
+    return (double)(NowNs() - startNs) / count;
+}
+
+// Video every 16667 us, AAC every 21333 us (1024 samples at 48 kHz),
+// interleaved by timestamp as the source would queue them.
+template<typename Queue>
+void Paced(int64_t durationUs, double *medianUs, double *maxUs) {
+    static const int64_t kVideoIntervalUs = 16667;
+    static const int64_t kAudioIntervalUs = 21333;
+
+    std::vector<int64_t> schedule;
+    for (int64_t v = 0, a = 0; v < durationUs || a < durationUs;) {
+        if (v <= a) {
+            schedule.push_back(v);
+            v += kVideoIntervalUs;
+        } else {
+            schedule.push_back(a);
+            a += kAudioIntervalUs;
+        }
+    }
+
+    Queue queue;
+    std::shared_ptr<std::vector<uint8_t> > buffer(new std::vector<uint8_t>(64 * 1024));
+
+    std::thread producer([&]() {
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < schedule.size(); ++i) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(schedule[i]));
+            Entry entry = MakeEntry(buffer, schedule[i]);
+            entry.mQueuedNs = NowNs();
+            queue.push(entry);
+        }
+    });
+
+    std::vector<int64_t> latenciesNs;
+    latenciesNs.reserve(schedule.size());
+    Entry entry;
+    for (size_t i = 0; i < schedule.size(); ++i) {
+        queue.pop(&entry);
+        latenciesNs.push_back(NowNs() - entry.mQueuedNs);
+    }
+    producer.join();
+
+    std::sort(latenciesNs.begin(), latenciesNs.end());
+    *medianUs = latenciesNs[latenciesNs.size() / 2] / 1E3;
+    *maxUs = latenciesNs.back() / 1E3;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    size_t count = 2000000;
+    int64_t pacedUs = 2000000;
+    if (argc > 1) {
+        count = (size_t)atol(argv[1]);
+    }
+    if (argc > 2) {
+        pacedUs = atol(argv[2]) * 1000ll;
+    }
+
+    printf("%-12s %14s %14s\n", "ns/AU", "mutex+list", "ring");
+    printf("%-12s %14.1f %14.1f\n", "uncontended",
+            Uncontended<ListQueue>(count), Uncontended<RingQueue>(count));
+    printf("%-12s %14.1f %14.1f\n", "streaming",
+            Streaming<ListQueue>(count), Streaming<RingQueue>(count));
+
+    double listMedianUs, listMaxUs, ringMedianUs, ringMaxUs;
+    Paced<ListQueue>(pacedUs, &listMedianUs, &listMaxUs);
+    Paced<RingQueue>(pacedUs, &ringMedianUs, &ringMaxUs);
+    printf("4K60 + AAC wake-up latency over %lld ms, us (median/max): "
+            "mutex+list %.1f/%.1f, ring %.1f/%.1f\n",
+            (long long)(pacedUs / 1000), listMedianUs, listMaxUs, ringMedianUs, ringMaxUs);
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2010 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DashPacketRing.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <thread>
+
+using namespace android;
+
+namespace {
+
+struct Entry {
+    Entry() : mTimeUs(-1), mSize(0), mIsDiscontinuity(false) {}
+
+    void releaseBuffer() { mBuffer.reset(); }
+
+    std::shared_ptr<int> mBuffer;
+    int64_t mTimeUs;
+    size_t mSize;
+    bool mIsDiscontinuity;
+};
+
+typedef DashPacketRing<Entry, 8> Ring;
+
+Entry MakeEntry(int64_t timeUs, size_t size) {
+    Entry entry;
+    entry.mBuffer.reset(new int(0));
+    entry.mTimeUs = timeUs;
+    entry.mSize = size;
+    return entry;
+}
+
+Entry MakeDiscontinuity() {
+    Entry entry;
+    entry.mIsDiscontinuity = true;
+    return entry;
+}
+
+}  // namespace
+
+TEST(DashPacketRingTest, PopsInOrderAcrossWrap) {
+    Ring ring;
+    Entry entry;
+    for (int64_t i = 0; i < 100; ++i) {
+        ASSERT_TRUE(ring.push(MakeEntry(i, 10)));
+        if (i % 3 == 2) {
+            for (int64_t j = i - 2; j <= i; ++j) {
+                ASSERT_TRUE(ring.pop(&entry));
+                EXPECT_EQ(j, entry.mTimeUs);
+            }
+        }
+    }
+    ASSERT_TRUE(ring.pop(&entry));
+    EXPECT_EQ(99, entry.mTimeUs);
+    EXPECT_FALSE(ring.pop(&entry));
+    EXPECT_EQ(0u, ring.bufferedBytes());
+}
+
+TEST(DashPacketRingTest, RefusesPushWhenFull) {
+    Ring ring;
+    for (int64_t i = 0; i < 8; ++i) {
+        ASSERT_TRUE(ring.push(MakeEntry(i, 1)));
+    }
+    EXPECT_FALSE(ring.push(MakeEntry(8, 1)));
+    EXPECT_EQ(8, ring.size());
+    EXPECT_EQ(8u, ring.bufferedBytes());
+
+    Entry entry;
+    ASSERT_TRUE(ring.pop(&entry));
+    EXPECT_TRUE(ring.push(MakeEntry(8, 1)));
+}
+
+TEST(DashPacketRingTest, ConsumedSlotReleasesPayload) {
+    Ring ring;
+    Entry queued = MakeEntry(0, 1);
+    std::weak_ptr<int> payload = queued.mBuffer;
+    ring.push(queued);
+    queued = Entry();
+
+    Entry entry;
+    ASSERT_TRUE(ring.pop(&entry));
+    entry = Entry();
+    EXPECT_TRUE(payload.expired());
+}
+
+TEST(DashPacketRingTest, FlushAccountsBytesImmediately) {
+    Ring ring;
+    for (int64_t i = 0; i < 5; ++i) {
+        ring.push(MakeEntry(i, 100));
+    }
+    Entry entry;
+    ASSERT_TRUE(ring.pop(&entry));
+    EXPECT_EQ(400u, ring.bufferedBytes());
+
+    // no consumer call between the flush and the query
+    ring.flush();
+    EXPECT_EQ(0u, ring.bufferedBytes());
+    EXPECT_EQ(0, ring.size());
+
+    ring.push(MakeEntry(10, 7));
+    EXPECT_EQ(7u, ring.bufferedBytes());
+    ASSERT_TRUE(ring.pop(&entry));
+    EXPECT_EQ(10, entry.mTimeUs);
+    EXPECT_EQ(0u, ring.bufferedBytes());
+}
+
+TEST(DashPacketRingTest, FlushReleasesPayloadOnNextPop) {
+    Ring ring;
+    Entry queued = MakeEntry(0, 1);
+    std::weak_ptr<int> payload = queued.mBuffer;
+    ring.push(queued);
+    queued = Entry();
+
+    ring.flush();
+    Entry entry;
+    EXPECT_FALSE(ring.pop(&entry));
+    EXPECT_TRUE(payload.expired());
+}
+
+TEST(DashPacketRingTest, SegmentTimesStartAfterLastDiscontinuity) {
+    Ring ring;
+    int64_t firstUs, lastUs;
+    EXPECT_FALSE(ring.getSegmentTimes(&firstUs, &lastUs));
+
+    ring.push(MakeEntry(1000, 1));
+    ring.push(MakeEntry(2000, 1));
+    ASSERT_TRUE(ring.getSegmentTimes(&firstUs, &lastUs));
+    EXPECT_EQ(1000, firstUs);
+    EXPECT_EQ(2000, lastUs);
+
+    ring.push(MakeDiscontinuity());
+    EXPECT_FALSE(ring.getSegmentTimes(&firstUs, &lastUs));
+
+    ring.push(MakeEntry(50000, 1));
+    ring.push(MakeEntry(53000, 1));
+    ASSERT_TRUE(ring.getSegmentTimes(&firstUs, &lastUs));
+    EXPECT_EQ(50000, firstUs);
+    EXPECT_EQ(53000, lastUs);
+
+    Entry entry;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(ring.pop(&entry));
+    }
+    ASSERT_TRUE(ring.getSegmentTimes(&firstUs, &lastUs));
+    EXPECT_EQ(53000, firstUs);
+    EXPECT_EQ(53000, lastUs);
+}
+
+// The producer queues increasing timestamps while this thread reads the
+// segment times and the consumer drains; every read must be a pair the
+// ring actually held, never a torn or reused slot.
+TEST(DashPacketRingTest, SegmentTimesConsistentUnderConcurrency) {
+    static const int64_t kCount = 200000;
+    static const int64_t kBase = 0x100000000ll;
+
+    Ring ring;
+    std::thread producer([&]() {
+        for (int64_t i = 0; i < kCount; ++i) {
+            while (!ring.push(MakeEntry(kBase + i, 1))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::thread consumer([&]() {
+        Entry entry;
+        for (int64_t i = 0; i < kCount;) {
+            if (ring.pop(&entry)) {
+                ASSERT_EQ(kBase + i, entry.mTimeUs);
+                ++i;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int64_t previousLastUs = -1;
+    for (int i = 0; i < kCount; ++i) {
+        int64_t firstUs, lastUs;
+        if (!ring.getSegmentTimes(&firstUs, &lastUs)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_GE(firstUs, kBase);
+        ASSERT_LE(firstUs, lastUs);
+        ASSERT_LT(lastUs - firstUs, 8);
+        ASSERT_GE(lastUs, previousLastUs);
+        previousLastUs = lastUs;
+    }
+
+    producer.join();
+    consumer.join();
+    EXPECT_EQ(0u, ring.bufferedBytes());
+}
+
+// flush() from a third thread while the consumer drains: whatever
+// interleaving, every byte is subtracted exactly once.
+TEST(DashPacketRingTest, BytesBalanceWithConcurrentFlush) {
+    static const int64_t kCount = 200000;
+
+    Ring ring;
+    volatile int32_t done = 0;
+    std::thread producer([&]() {
+        for (int64_t i = 0; i < kCount; ++i) {
+            while (!ring.push(MakeEntry(i, 3))) {
+                std::this_thread::yield();
+            }
+        }
+        android_atomic_release_store(1, &done);
+    });
+    std::thread flusher([&]() {
+        while (!android_atomic_acquire_load(&done)) {
+            ring.flush();
+            std::this_thread::yield();
+        }
+    });
+
+    Entry entry;
+    while (!android_atomic_acquire_load(&done) || ring.size() > 0) {
+        if (!ring.pop(&entry)) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    flusher.join();
+    while (ring.pop(&entry)) {
+    }
+    EXPECT_EQ(0u, ring.bufferedBytes());
+}